@@ -0,0 +1,252 @@
+/******************************************************************************
+
+    File:   BitDecoder.h
+    Desc:   Decodes a status or flag register for all DUTs at once into a
+            flag mask per DUT.  Flag names come from the fields of a register
+            map (RegisterMap.h) that fall in the register, and set bits are
+            visited with a count-trailing-zeros loop.  Strings are only built
+            by ToString and Print.
+
+            Example:
+
+            BitDecoder status;
+            byte addr[] = { 0x20, 0x21 };
+            status.Load(KRam::Table, KRam::COUNT, PAGE_00, addr, 2);
+            status.Decode(img, listDut);
+            if (status.Test(dut, KRam::osc_fail::Field())) ...
+
+******************************************************************************/
+#ifndef _BIT_DECODER_H_
+#define _BIT_DECODER_H_
+
+#include "Defines.h"
+#include "Utilities.h"
+#include "RegisterMap.h"
+
+#define BITDECODER_MAX_BYTES    4
+#define BITDECODER_MAX_BITS     (BITDECODER_MAX_BYTES * 8)
+
+//-----------------------------------------------------------------------------
+//  BitDecoder struct
+typedef struct BitDecoder
+{
+    const char*     Names[BITDECODER_MAX_BITS]; // field owning each bit, NULL if none
+    byte            Position[BITDECODER_MAX_BITS]; // bit within that field
+    byte            Width[BITDECODER_MAX_BITS]; // bits in that field
+    int             Rows[BITDECODER_MAX_BYTES]; // rows in Raw, least significant first
+    byte            Page;
+    byte            Addr[BITDECODER_MAX_BYTES];
+    int             num;
+    dword           Known;                      // bits that have a name
+
+    // results of the last Decode
+    dword           Flags[TOOL_MAX_DUT];
+    dword           Any;                        // set on at least one DUT
+    dword           All;                        // set on every DUT
+
+    BitDecoder(void) : num(0), Known(0), Any(0), All(0)
+    {
+        memset(Names, 0, sizeof(Names));
+        memset(Flags, 0, sizeof(Flags));
+    }
+
+    // set bits of value, lowest first
+    template <typename F>
+    static void ForEachBit(dword value, F f)
+    {
+        for (; value != 0; value &= value - 1)
+            f(CUtilities::CountTrailingZeros(value));
+    }
+
+    // loads a register of count bytes (least significant first) from a map
+    // table; rows follow the map's own layout, as used by RegFieldRef
+    int Load(const RegField* t, int n, byte page, const byte* addr, int count)
+    {
+        DBGTrace("---> BitDecoder::Load");
+
+        if ((count < 1) || (count > BITDECODER_MAX_BYTES))
+        {
+            ERRLog(ERROR_INIT, "BitDecoder register must be 1 to BITDECODER_MAX_BYTES bytes.");
+            return ERROR_INIT;
+        }
+
+        memset(Names, 0, sizeof(Names));
+        Known = 0;
+        Page = page;
+        num = count;
+
+        for (int r = 0; r < count; r++)
+        {
+            bool found = false;
+            int key = (page << 8) | addr[r];
+
+            Addr[r] = addr[r];
+            Rows[r] = RegMapBytes(t, n, key);
+
+            for (int i = 0; i < n; i++)
+            {
+                int pos = 0;
+
+                for (int a = 0; a < t[i].num; a++)
+                {
+                    byte mask = t[i].mask[a];
+
+                    if (RegKey(t[i], a) != key)
+                    {
+                        pos += RegBits(mask);
+                        continue;
+                    }
+
+                    found = true;
+                    for (; mask != 0; mask &= mask - 1)
+                    {
+                        int bit = (r * 8) + CUtilities::CountTrailingZeros(mask);
+
+                        Names[bit] = t[i].name;
+                        Position[bit] = (byte)pos++;
+                        Width[bit] = (byte)RegFieldBits(t[i]);
+                        Known |= (dword)1 << bit;
+                    }
+                }
+            }
+
+            if (!found)
+            {
+                String msg;
+                sprintf(msg, "BitDecoder: page %02X addr %02X is not in the map.", page, addr[r]);
+                ERRLog(ERROR_INIT, msg);
+                num = 0;
+                return ERROR_INIT;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    // raw is laid out like Image::Raw for the map given to Load
+    void Decode(const byte* raw, word* listDut)
+    {
+        int dut;
+
+        memset(Flags, 0, sizeof(Flags));
+
+        for (int r = 0; r < num; r++)
+        {
+            const byte* row = &raw[Rows[r] * TOOL_MAX_DUT];
+            const int shift = r * 8;
+
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                Flags[dut] |= (dword)row[dut] << shift;
+            }
+        }
+
+        Any = 0;
+        All = (listDut[0] != 0) ? 0xFFFFFFFF : 0;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            Any |= Flags[dut];
+            All &= Flags[dut];
+        }
+    }
+
+    void Decode(Image& img, word* listDut)
+    {
+        Decode(&img.Raw[0][0], listDut);
+    }
+
+    dword Get(int dut) { return Flags[dut]; }
+    bool Test(int dut, int bit) { return (Flags[dut] >> bit) & 1; }
+
+    // first bit of a named field in this register, or -1
+    int Bit(const char* name)
+    {
+        for (dword known = Known; known != 0; known &= known - 1)
+        {
+            int bit = CUtilities::CountTrailingZeros(known);
+            if ((Position[bit] == 0) && (strcmp(Names[bit], name) == 0))
+                return bit;
+        }
+        return -1;
+    }
+
+    bool Test(int dut, const RegField& field)
+    {
+        int bit = Bit(field.name);
+        return (bit >= 0) && Test(dut, bit);
+    }
+
+    // number of DUTs with a bit set
+    int Count(int bit, word* listDut)
+    {
+        int count = 0;
+
+        for (int d = 0; listDut[d] != 0; d++)
+            count += (Flags[listDut[d] - 1] >> bit) & 1;
+
+        return count;
+    }
+
+    // names of the set bits, "name" for single bit fields, "name[n]" for
+    // bits of wider fields and "bitN" for bits not in the map.  Stops at
+    // the last name that fits in size bytes.
+    void ToString(dword value, char* output, int size)
+    {
+        int used = 0;
+        int n;
+
+        if (size <= 0)
+            return;
+        output[0] = '\0';
+
+        ForEachBit(value, [&](int bit)
+        {
+            if (used < 0)
+                return;
+
+            if (Names[bit] == NULL)
+                n = snprintf(&output[used], size - used, "bit%i ", bit);
+            else if (Width[bit] == 1)
+                n = snprintf(&output[used], size - used, "%s ", Names[bit]);
+            else
+                n = snprintf(&output[used], size - used, "%s[%i] ", Names[bit], Position[bit]);
+
+            if ((n < 0) || (n >= size - used))
+            {
+                // drop the partial name
+                output[used] = '\0';
+                used = -1;
+                return;
+            }
+            used += n;
+        });
+    }
+
+    void Print(word* listDut)
+    {
+        int dut, len;
+        char msg[APP_MAX_CHAR_LONGER];
+
+        // always display
+        bool was_on = DBGVerboseEnabled;
+        DBGVerboseEnabled = YES;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            if (Flags[dut] == 0)
+                continue;
+
+            len = sprintf(msg, "\nBitDecoder [%i] page %02X addr %02X: ", dut, Page, Addr[0]);
+            ToString(Flags[dut], &msg[len], APP_MAX_CHAR_LONGER - len);
+            DBGVerbose(msg);
+        }
+
+        DBGVerboseEnabled = was_on;
+    }
+} BitDecoder;
+
+#endif
@@ -0,0 +1,286 @@
+/******************************************************************************
+
+    File:   CompactImage.h
+    Desc:   Register image with width-packed decoded values.  Image keeps a
+            full int per value per DUT, but most fields are only a few bits
+            wide, so CompactImage stores each decoded value row as int8,
+            int16 or int32 depending on the field width in the register map.
+
+******************************************************************************/
+#ifndef _COMPACT_IMAGE_H_
+#define _COMPACT_IMAGE_H_
+
+#include <vector>
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+#include "RegisterMap.h"
+
+//-----------------------------------------------------------------------------
+//  PackedLayout struct
+//  Width and offset of every decoded value row.  Build once per register
+//  map and share between all CompactImages using that map.
+typedef struct PackedLayout
+{
+    int             count;                          // number of values
+    byte            width[NUM_RAM_VALUES];          // 1, 2 or 4 bytes
+    bool            sign[NUM_RAM_VALUES];           // sign extend on read
+    int             offset[NUM_RAM_VALUES];         // start of the value row, aligned to width
+    int             size;                           // decoded bytes per image
+
+    PackedLayout(void) : count(0), size(0) {}
+
+    PackedLayout(const RegField* t, int n) { Build(t, n); }
+
+    PackedLayout(RAMstruct& RAMregisters) { Build(RAMregisters); }
+
+    void Build(const RegField* t, int n)
+    {
+        int bits;
+
+        Clear();
+        for (int i = 0; (i < n) && (i < NUM_RAM_VALUES); i++)
+        {
+            bits = RegFieldBits(t[i]);
+            Append(bits, t[i].conversion);
+        }
+    }
+
+    void Build(RAMstruct& RAMregisters)
+    {
+        int bits;
+        vector<ASICregister>::iterator it;
+
+        Clear();
+        for (it = RAMregisters.RAMvector.begin(); it != RAMregisters.RAMvector.end(); ++it)
+        {
+            bits = 0;
+            for (int a = 0; a < it->num_registers; a++)
+                bits += RegBits(it->mask[a]);
+            Append(bits, it->conversion.type);
+        }
+    }
+
+    void Clear(void)
+    {
+        count = 0;
+        size = 0;
+        memset(width, 0, sizeof(width));
+        memset(sign, 0, sizeof(sign));
+        memset(offset, 0, sizeof(offset));
+    }
+
+    // add a value row wide enough for bits of the given conversion
+    void Append(int bits, contype conv)
+    {
+        if (count >= NUM_RAM_VALUES)
+        {
+            ERRLog(ERROR_INIT, "PackedLayout has more values than NUM_RAM_VALUES.");
+            return;
+        }
+
+        switch (conv)
+        {
+        case convert_bit:
+        case convert_byte:
+        case convert_uint:
+            sign[count] = false;
+            break;
+
+        case twos_comp:
+            sign[count] = true;
+            break;
+
+        default:
+            // not decoded by width yet, keep a full int
+            sign[count] = true;
+            bits = 32;
+            break;
+        }
+
+        width[count] = (bits <= 8) ? 1 : ((bits <= 16) ? 2 : 4);
+        size = (size + width[count] - 1) & ~(width[count] - 1);
+        offset[count] = size;
+        size += width[count] * TOOL_MAX_DUT;
+        count++;
+    }
+} PackedLayout;
+
+//-----------------------------------------------------------------------------
+//  CompactImage struct
+//  Used for holding many snapshots of the same RAM/ROM image.  Raw is the
+//  same as Image::Raw, and Decoded holds the value rows described by layout.
+typedef struct CompactImage
+{
+    byte                    Raw[NUM_RAM_REG][TOOL_MAX_DUT];
+    vector<byte>            Decoded;
+    const PackedLayout*     layout;
+    mtype                   memory;
+    byte                    page;
+
+    CompactImage(void) : layout(NULL), memory(Volatile), page(PAGE_00) {}
+
+    CompactImage(const PackedLayout* layout_in, mtype mem_in, byte page_in)
+        : Decoded(layout_in->size, 0), layout(layout_in), memory(mem_in), page(page_in)
+    {
+        memset(Raw, 0x00, sizeof(Raw));
+    }
+
+    // snapshot of an Image (raw and converted values)
+    CompactImage(const PackedLayout* layout_in, Image& img, word* listDut)
+        : Decoded(layout_in->size, 0), layout(layout_in), memory(img.memory.type), page(img.page)
+    {
+        memcpy(Raw, img.Raw, sizeof(Raw));
+        SetConverted(&img.Converted[0][0], listDut);
+    }
+
+    void SetRaw(byte* raw_in)
+    {
+        memcpy(Raw, raw_in, sizeof(Raw));
+    }
+
+    // typed row access, T[TOOL_MAX_DUT]; NULL if T is not the row's width.
+    // Rows are aligned to their width within Decoded.
+    template <typename T> T* Row(int value)
+    {
+        if (sizeof(T) != layout->width[value])
+        {
+            ERRLog(ERROR_UNDEFINED, "CompactImage row accessed with the wrong width.");
+            return NULL;
+        }
+        return (T*)&Decoded[layout->offset[value]];
+    }
+
+    // generic access for any width, values are copied in and out with memcpy
+    int Get(int value, int dut)
+    {
+        int width = layout->width[value];
+        const byte* p = &Decoded[layout->offset[value] + dut * width];
+        word w;
+        int i;
+
+        switch (width)
+        {
+        case 1:
+            return layout->sign[value] ? (int)(signed char)p[0] : (int)p[0];
+        case 2:
+            memcpy(&w, p, sizeof(w));
+            return layout->sign[value] ? (int)(short)w : (int)w;
+        default:
+            memcpy(&i, p, sizeof(i));
+            return i;
+        }
+    }
+
+    void Set(int value, int dut, int v)
+    {
+        int width = layout->width[value];
+        byte* p = &Decoded[layout->offset[value] + dut * width];
+        word w = (word)v;
+
+        switch (width)
+        {
+        case 1:
+            p[0] = (byte)v;
+            break;
+        case 2:
+            memcpy(p, &w, sizeof(w));
+            break;
+        default:
+            memcpy(p, &v, sizeof(v));
+            break;
+        }
+    }
+
+    // narrow a Converted[NUM_RAM_VALUES][TOOL_MAX_DUT] array into Decoded
+    void SetConverted(int* converted, word* listDut)
+    {
+        for (int v = 0; v < layout->count; v++)
+        {
+            int* row = &converted[v * TOOL_MAX_DUT];
+
+            switch (layout->width[v])
+            {
+            case 1:
+                Narrow(Row<signed char>(v), row, listDut);
+                break;
+            case 2:
+                Narrow(Row<short>(v), row, listDut);
+                break;
+            default:
+                Narrow(Row<int>(v), row, listDut);
+                break;
+            }
+        }
+    }
+
+    // widen Decoded back into a Converted[NUM_RAM_VALUES][TOOL_MAX_DUT] array
+    void GetConverted(int* converted, word* listDut)
+    {
+        for (int v = 0; v < layout->count; v++)
+        {
+            int* row = &converted[v * TOOL_MAX_DUT];
+            bool sign = layout->sign[v];
+
+            switch (layout->width[v])
+            {
+            case 1:
+                if (sign)
+                    Widen(Row<signed char>(v), row, listDut);
+                else
+                    Widen(Row<byte>(v), row, listDut);
+                break;
+            case 2:
+                if (sign)
+                    Widen(Row<short>(v), row, listDut);
+                else
+                    Widen(Row<word>(v), row, listDut);
+                break;
+            default:
+                Widen(Row<int>(v), row, listDut);
+                break;
+            }
+        }
+    }
+
+    // restore into a full Image
+    void ToImage(Image& img, word* listDut)
+    {
+        memcpy(img.Raw, Raw, sizeof(Raw));
+        img.memory = memory_type(memory);
+        img.page = page;
+        img.MarkAllDirty();
+        GetConverted(&img.Converted[0][0], listDut);
+    }
+
+    // decoded bytes saved per snapshot compared to Image::Converted
+    int Savings(void)
+    {
+        return (int)(NUM_RAM_VALUES * TOOL_MAX_DUT * sizeof(int)) - layout->size;
+    }
+
+private:
+    template <typename T> static void Narrow(T* out, const int* row, word* listDut)
+    {
+        int dut;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            out[dut] = (T)row[dut];
+        }
+    }
+
+    template <typename T> static void Widen(const T* in, int* row, word* listDut)
+    {
+        int dut;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            row[dut] = (int)in[dut];
+        }
+    }
+} CompactImage;
+
+#endif
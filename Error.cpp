@@ -8,8 +8,18 @@
 ******************************************************************************/
 #include "Testbench.h"
 #include "Error.h"
+#include "LogFile.h"
 
 bool CError::EnableWarnings = NO;
+int CError::LogFirst = ERROR_LOG_FIRST;
+int CError::LogWindow = ERROR_LOG_WINDOW;
+ErrorCounter CError::Counters[ERROR_TABLE_SIZE];
+std::atomic<dword> CError::DutCounts[TOOL_MAX_DUT];
+bool CError::Isolation = NO;
+bool CError::Masked[TOOL_MAX_DUT];
+int CError::MaskedCount = 0;
+
+#define ERROR_SUFFIX    "\nPlease contact Software Engineering.\n"
 
 /******************************************************************************
     Name:   CError
@@ -30,7 +40,7 @@ CError::~CError(void)
 /******************************************************************************
     Name:   Display
     Desc:   Displays the various error messages in the console, output window
-            and generated log file.
+            and generated log file (the rotating CLogFile when it is open).
 ******************************************************************************/
 void CError::Display(char* label, char* msg)
 {
@@ -38,7 +48,10 @@ void CError::Display(char* label, char* msg)
     
     cout << label << msg << endl;
     CTestbench::DisplayToOutputWindow(label, msg);
-    CTestbench::WriteToLogFile(label, msg);
+    if (CLogFile::IsOpen())
+        CLogFile::Write(label, msg);
+    else
+        CTestbench::WriteToLogFile(label, msg);
 }
 
 /******************************************************************************
@@ -51,9 +64,8 @@ void CError::DisplayCode(int status)
     
     String label;
     sprintf(label, "ERROR CODE: %i - ", status);
-    String errorcode = CError::CodeToString(status);
     
-    CError::Display(label, errorcode);
+    CError::Display(label, (char*)CError::CodeToString(status));
 }
 
 /******************************************************************************
@@ -91,12 +103,27 @@ void CError::Add(char* msg)
 ******************************************************************************/
 void CError::Add(int status, char* msg)
 {
+    if (!CError::ShouldLog(status))
+        return;
+    
     String label = "ERROR: ";
     
     CError::Display(label, msg);
     CError::DisplayCode(status);
 }
 
+/******************************************************************************
+    Name:   Add
+    Desc:   Same as above, and counts the error against a DUT (0 based)
+******************************************************************************/
+void CError::Add(int status, char* msg, int dut)
+{
+    if ((dut >= 0) && (dut < TOOL_MAX_DUT))
+        CError::DutCounts[dut]++;
+    
+    CError::Add(status, msg);
+}
+
 /******************************************************************************
     Name:   Critical
     Desc:   
@@ -107,6 +134,9 @@ void CError::Critical(int status, char* msg)
     
     String crit = "!!! CRITICAL ERROR !!! ";
     
+    // counted, but never suppressed
+    CError::Count(status);
+    
     CError::Display(crit, msg);
     CError::DisplayCode(status);
     
@@ -159,6 +189,9 @@ void CError::Check(int status, char* msg, char* label_in, bool critical)
             return;
         }
         
+        if (!CError::ShouldLog(status))
+            return;
+        
         CError::Display(label,msg);
         CError::DisplayCode(status);
     }
@@ -166,56 +199,346 @@ void CError::Check(int status, char* msg, char* label_in, bool critical)
         return;
 }
 
+/******************************************************************************
+    Name:   IsolateDut
+    Desc:   Handles a failed status that belongs to one DUT (0 based).  With
+            isolation on, a hardware error masks the DUT out of the rest of
+            the flow; otherwise it is handled like Check.
+******************************************************************************/
+void CError::IsolateDut(int status, char* msg, int dut)
+{
+    DBGTrace("---> CError::IsolateDut");
+    
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT) || !CError::Isolation || !CError::IsHardware(status))
+    {
+        if ((dut >= 0) && (dut < TOOL_MAX_DUT))
+            CError::DutCounts[dut]++;
+        CError::Check(status, msg);
+        return;
+    }
+    
+    String label;
+    sprintf(label, "Dut %02d masked out: %s", dut + 1, msg);
+    CError::Add(status, label, dut);
+    CError::MaskDut(dut);
+}
+
+/******************************************************************************
+    Name:   IsolateSites
+    Desc:   Same as IsolateDut for an error that belongs to a group of sites
+            (e.g. a whole chamber).  When not isolating, the error goes through
+            Check once and is counted against every site.
+******************************************************************************/
+void CError::IsolateSites(int status, char* msg, word* listDut)
+{
+    DBGTrace("---> CError::IsolateSites");
+    
+    if (!CError::Isolation || !CError::IsHardware(status))
+    {
+        for (int d = 0; listDut[d] != 0; d++)
+            CError::DutCounts[listDut[d] - 1]++;
+        CError::Check(status, msg);
+        return;
+    }
+    
+    for (int d = 0; listDut[d] != 0; d++)
+        CError::IsolateDut(status, msg, listDut[d] - 1);
+}
+
+/******************************************************************************
+    Name:   IsHardware
+    Desc:   Error codes that isolation masks a site for
+******************************************************************************/
+bool CError::IsHardware(int status)
+{
+    return (status == ERROR_HW_CRITICAL) || (status == ERROR_HARDWARE) ||
+           (status == ERROR_COMMUNICATION);
+}
+
+/******************************************************************************
+    Name:   MaskDut
+    Desc:   Removes a DUT (0 based) from the remaining steps of the flow
+******************************************************************************/
+void CError::MaskDut(int dut)
+{
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT) || CError::Masked[dut])
+        return;
+    
+    CError::Masked[dut] = true;
+    CError::MaskedCount++;
+}
+
+/******************************************************************************
+    Name:   ApplyMask
+    Desc:   Removes masked DUTs from a zero terminated listDut in place
+******************************************************************************/
+void CError::ApplyMask(word* listDut)
+{
+    if (CError::MaskedCount == 0)
+        return;
+    
+    int keep = 0;
+    
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        if (!CError::Masked[listDut[d] - 1])
+            listDut[keep++] = listDut[d];
+    }
+    
+    listDut[keep] = 0;
+}
+
+/******************************************************************************
+    Name:   ClearMask
+    Desc:   Unmasks every DUT (start of an insertion)
+******************************************************************************/
+void CError::ClearMask(void)
+{
+    memset(CError::Masked, 0, sizeof(CError::Masked));
+    CError::MaskedCount = 0;
+}
+
 /******************************************************************************
     Name:   CodeToString
-    Desc:   Convert to string using ErrorCodes.h
+    Desc:   Convert to string using ErrorCodes.h.  The messages are constant,
+            so nothing is built per call.
 ******************************************************************************/
-String CError::CodeToString(int code)
+const char* CError::CodeToString(int code)
 {
     DBGTrace("---> CError::CodeToString");
     
-    String msg;
-    
     switch(code)
     {
         case SUCCESS:
-             msg = "Success!!";
-             break;
+            return "Success!!" ERROR_SUFFIX;
         case ERROR_SPEC:
-            msg = "Something humorous about a spec. Contact Paul Crossen.";
-             break;
+            return "Something humorous about a spec. Contact Paul Crossen." ERROR_SUFFIX;
         case ERROR_INIT:
-            msg = "Aw, snap!  Something did not get initialized correctly.";
-             break;
+            return "Aw, snap!  Something did not get initialized correctly." ERROR_SUFFIX;
         case ERROR_RUN:
-            msg = "Aw, shucks!  You're trying to ride a dead horse (again).";
-             break;
+            return "Aw, shucks!  You're trying to ride a dead horse (again)." ERROR_SUFFIX;
         case ERROR_UNIMPLEMENTED:
-            msg = "Oops!  We forgot to implement that...";
-             break;
+            return "Oops!  We forgot to implement that..." ERROR_SUFFIX;
         case ERROR_UNDEFINED:
-            msg = "Some part of the code here is undefined, abandoned, and feeling alone.";
-             break;
+            return "Some part of the code here is undefined, abandoned, and feeling alone." ERROR_SUFFIX;
         case ERROR_COMMUNICATION:
-            msg = "Communication is overrated.";
-             break;
+            return "Communication is overrated." ERROR_SUFFIX;
         case WARN_HARDWARE:
-            msg = "I might not be qualified to handle hardware debug.";
-             break;
+            return "I might not be qualified to handle hardware debug." ERROR_SUFFIX;
         case ERROR_HARDWARE:
-            msg = "I am definitely not qualified to handle hardware debug.";
-             break;
+            return "I am definitely not qualified to handle hardware debug." ERROR_SUFFIX;
         case ERROR_HW_CRITICAL:
-            msg = "Critical Hardware Error.  He's dead, Jim.";
-             break;
+            return "Critical Hardware Error.  He's dead, Jim." ERROR_SUFFIX;
         case SIMULATE_HARDWARE:
-            msg = "You know you don't have hardware...  Moving along then.";
-             break;
+            return "You know you don't have hardware...  Moving along then." ERROR_SUFFIX;
         default:
-            msg = "I don't even know what you want right now... but I'm not going to do it.";
-             break;
+            return "I don't even know what you want right now... but I'm not going to do it." ERROR_SUFFIX;
+    }
+}
+
+/******************************************************************************
+    Name:   SetRateLimit
+    Desc:   Log only the first occurrences of each error code in every window
+            of window_seconds, then a summary of what was suppressed.
+            first = 0 logs everything.
+******************************************************************************/
+void CError::SetRateLimit(int first, int window_seconds)
+{
+    CError::LogFirst = first;
+    CError::LogWindow = window_seconds;
+}
+
+/******************************************************************************
+    Name:   Counter
+    Desc:   Finds (or claims) the counter slot for an error code without
+            locking.  Returns NULL if the table is full.
+******************************************************************************/
+ErrorCounter* CError::Counter(int code)
+{
+    unsigned int start = ((unsigned int)code * 2654435761u) % ERROR_TABLE_SIZE;
+    
+    for (int i = 0; i < ERROR_TABLE_SIZE; i++)
+    {
+        ErrorCounter* counter = &CError::Counters[(start + i) % ERROR_TABLE_SIZE];
+        int key = counter->code.load();
+        
+        if (key == code)
+            return counter;
+        
+        if (key == SUCCESS)
+        {
+            // claim the empty slot, unless someone else just did
+            if (counter->code.compare_exchange_strong(key, code) || (key == code))
+                return counter;
+        }
+    }
+    
+    return NULL;
+}
+
+/******************************************************************************
+    Name:   Count
+    Desc:   Counts an occurrence of code.  At the start of each window, prints
+            how many were suppressed in the last.  Returns the counter, or
+            NULL for SUCCESS or a full table.
+******************************************************************************/
+ErrorCounter* CError::Count(int code)
+{
+    if (code == SUCCESS)
+        return NULL;
+    
+    ErrorCounter* counter = CError::Counter(code);
+    if (counter == NULL)
+        return NULL;
+    
+    counter->total++;
+    
+    long long now = (long long)time(NULL);
+    long long start = counter->start.load();
+    
+    if ((now - start) >= CError::LogWindow)
+    {
+        if (counter->start.compare_exchange_strong(start, now))
+        {
+            counter->window.store(0);
+            CError::ReportSuppressed(counter, CError::LogWindow);
+        }
+    }
+    
+    return counter;
+}
+
+/******************************************************************************
+    Name:   ShouldLog
+    Desc:   Counts an occurrence of code and decides whether to log it
+******************************************************************************/
+bool CError::ShouldLog(int code)
+{
+    ErrorCounter* counter = CError::Count(code);
+    if (counter == NULL)
+        return true;
+    
+    if ((CError::LogFirst <= 0) || ((int)++counter->window <= CError::LogFirst))
+        return true;
+    
+    counter->suppressed++;
+    return false;
+}
+
+/******************************************************************************
+    Name:   ReportSuppressed
+    Desc:   Prints how many occurrences of a code were not logged over the
+            last seconds, and clears the count
+******************************************************************************/
+void CError::ReportSuppressed(ErrorCounter* counter, long long seconds)
+{
+    dword missed = counter->suppressed.exchange(0);
+    
+    if (missed > 0)
+    {
+        String msg;
+        sprintf(msg, "code %i occurred %u more times in the last %i s (not logged)",
+            counter->code.load(), missed, (int)seconds);
+        CError::Display("ERROR SUMMARY: ", msg);
+    }
+}
+
+/******************************************************************************
+    Name:   FlushSuppressed
+    Desc:   Prints the suppression summary of every code now, instead of
+            when the code next occurs (end of lot)
+******************************************************************************/
+void CError::FlushSuppressed(void)
+{
+    long long now = (long long)time(NULL);
+    
+    for (int i = 0; i < ERROR_TABLE_SIZE; i++)
+    {
+        if (CError::Counters[i].code.load() == SUCCESS)
+            continue;
+        
+        CError::ReportSuppressed(&CError::Counters[i], now - CError::Counters[i].start.load());
+    }
+}
+
+/******************************************************************************
+    Name:   GetCount
+    Desc:   Number of times an error code has occurred since ResetCounts
+******************************************************************************/
+dword CError::GetCount(int code)
+{
+    for (int i = 0; i < ERROR_TABLE_SIZE; i++)
+    {
+        if (CError::Counters[i].code.load() == code)
+            return CError::Counters[i].total.load();
+    }
+    
+    return 0;
+}
+
+/******************************************************************************
+    Name:   GetDutCount
+    Desc:   Number of errors counted against a DUT (0 based)
+******************************************************************************/
+dword CError::GetDutCount(int dut)
+{
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT))
+        return 0;
+    
+    return CError::DutCounts[dut].load();
+}
+
+/******************************************************************************
+    Name:   Summary
+    Desc:   Logs what is still suppressed, then the totals for every error
+            code and DUT (end of lot)
+******************************************************************************/
+void CError::Summary(void)
+{
+    DBGTrace("---> CError::Summary");
+    
+    String msg;
+    dword count;
+    
+    CError::FlushSuppressed();
+    
+    for (int i = 0; i < ERROR_TABLE_SIZE; i++)
+    {
+        if (CError::Counters[i].code.load() == SUCCESS)
+            continue;
+        
+        sprintf(msg, "code %i occurred %u times",
+            CError::Counters[i].code.load(), CError::Counters[i].total.load());
+        CError::Display("ERROR SUMMARY: ", msg);
+    }
+    
+    for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+    {
+        count = CError::DutCounts[dut].load();
+        if (count == 0)
+            continue;
+        
+        sprintf(msg, "Dut %02d had %u errors", dut + 1, count);
+        CError::Display("ERROR SUMMARY: ", msg);
+    }
+}
+
+/******************************************************************************
+    Name:   ResetCounts
+    Desc:   Clears all counters (start of lot).  Not safe while other threads
+            are adding errors.
+******************************************************************************/
+void CError::ResetCounts(void)
+{
+    for (int i = 0; i < ERROR_TABLE_SIZE; i++)
+    {
+        CError::Counters[i].code.store(SUCCESS);
+        CError::Counters[i].total.store(0);
+        CError::Counters[i].window.store(0);
+        CError::Counters[i].suppressed.store(0);
+        CError::Counters[i].start.store(0);
     }
     
-    strcat(msg, "\nPlease contact Software Engineering.\n");
-    return msg;
+    for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+        CError::DutCounts[dut].store(0);
 }
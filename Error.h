@@ -9,26 +9,65 @@
 #ifndef _ERROR_H_
 #define _ERROR_H_
 
+#include <atomic>
+
+#define ERROR_TABLE_SIZE        64      // distinct error codes counted
+#define ERROR_LOG_FIRST         20      // occurrences logged per code per window
+#define ERROR_LOG_WINDOW        60      // seconds
+
+//-----------------------------------------------------------------------------
+//  per-code error counter (one slot in a lock-free open addressed table)
+typedef struct ErrorCounter
+{
+    std::atomic<int>        code;       // SUCCESS marks an empty slot
+    std::atomic<dword>      total;
+    std::atomic<dword>      window;     // occurrences in the current window
+    std::atomic<dword>      suppressed; // not logged in the current window
+    std::atomic<long long>  start;      // time the current window started
+} ErrorCounter;
+
 //-----------------------------------------------------------------------------
 //  Error class definition
 class CError
 {
 private:
     static bool EnableWarnings;
+    static int LogFirst;
+    static int LogWindow;
+    static ErrorCounter Counters[ERROR_TABLE_SIZE];
+    static std::atomic<dword> DutCounts[TOOL_MAX_DUT];
+    static bool Isolation;
+    static bool Masked[TOOL_MAX_DUT];
+    static int MaskedCount;
     
     static void Display(char* label, char* msg);
     static void DisplayCode(int status);
-    static String CodeToString(int code);
+    static const char* CodeToString(int code);
+    static ErrorCounter* Counter(int code);
+    static ErrorCounter* Count(int code);
+    static bool ShouldLog(int code);
+    static void ReportSuppressed(ErrorCounter* counter, long long seconds);
+    static bool IsHardware(int status);
+    static void IsolateDut(int status, char* msg, int dut);
+    static void IsolateSites(int status, char* msg, word* listDut);
 
 public:
     CError(void);
     ~CError(void);
     
     static void SetWarnings(bool state) { CError::EnableWarnings = state; }
+    static void SetRateLimit(int first, int window_seconds);
     
     static void Warn(char* msg);
     static void Add(char* msg);
     static void Add(int status, char* msg);
+    static void Add(int status, char* msg, int dut);
+    
+    static dword GetCount(int code);
+    static dword GetDutCount(int dut);
+    static void FlushSuppressed(void);
+    static void Summary(void);
+    static void ResetCounts(void);
     
     /* TODO: Implement these more completely */
     static void Critical(int status, char* msg);
@@ -37,6 +76,27 @@ public:
     static void Check(int status, char* msg, char* label_in, bool critical = false);
     /* TODO: Implement these more completely */
     
+    // per-DUT failure isolation: with isolation on, hardware errors that
+    // belong to a DUT (or a group of sites) mask those sites out instead of
+    // aborting the flow.  Errors with no site still go through Check.
+    static void SetIsolation(bool state) { CError::Isolation = state; }
+    static bool GetIsolation(void) { return CError::Isolation; }
+    static void CheckDut(int status, char* msg, int dut)
+    {
+        if (status != SUCCESS)
+            CError::IsolateDut(status, msg, dut);
+    }
+    static void CheckSites(int status, char* msg, word* listDut)
+    {
+        if (status != SUCCESS)
+            CError::IsolateSites(status, msg, listDut);
+    }
+    static void MaskDut(int dut);
+    static bool IsMasked(int dut) { return (dut >= 0) && (dut < TOOL_MAX_DUT) && CError::Masked[dut]; }
+    static int GetMaskedCount(void) { return CError::MaskedCount; }
+    static void ApplyMask(word* listDut);
+    static void ClearMask(void);
+    
     /* TODO: Implement these */
     static void MsgBox(int status, char* msg);
     /* TODO: Implement these */
@@ -0,0 +1,350 @@
+/******************************************************************************
+
+    File:   FailHeatmap.cpp
+    Desc:   FailHeatmap keeps running fail counts across a lot from the XOR
+            diff matrices produced by the image compares, per (register, bit)
+            and per socket.
+
+******************************************************************************/
+#include "FailHeatmap.h"
+#include "SlicedImage.h"
+
+/******************************************************************************
+    Name:   FailHeatmap
+    Desc:   Default constructor
+******************************************************************************/
+FailHeatmap::FailHeatmap(void)
+{
+    this->Reset();
+}
+
+/******************************************************************************
+    Name:   ~FailHeatmap
+    Desc:   Default destructor
+******************************************************************************/
+FailHeatmap::~FailHeatmap(void)
+{
+}
+
+/******************************************************************************
+    Name:   Reset
+    Desc:   Clears all counts at the start of a lot
+******************************************************************************/
+void FailHeatmap::Reset(void)
+{
+    memset(this->BitFails, 0, sizeof(this->BitFails));
+    memset(this->SocketFails, 0, sizeof(this->SocketFails));
+    memset(this->SocketBits, 0, sizeof(this->SocketBits));
+    memset(this->SocketTested, 0, sizeof(this->SocketTested));
+    this->Compares = 0;
+    this->Rows = 0;
+}
+
+/******************************************************************************
+    Name:   Add
+    Desc:   Adds one diff matrix (difference[row][TOOL_MAX_DUT], as filled by
+            Image::Compare or Default::CompareMasked).  Each register bit is
+            gathered into DUT lanes, 64 DUTs per word, and counted with a
+            popcount.
+******************************************************************************/
+void FailHeatmap::Add(byte* difference, int rows, word* listDut)
+{
+    DBGTrace("---> FailHeatmap::Add");
+
+    int dut;
+    byte value;
+    qword lanes[8][HEATMAP_LANES];
+    qword failed[HEATMAP_LANES];
+
+    if (rows > HEATMAP_MAX_ROWS)
+        rows = HEATMAP_MAX_ROWS;
+    if (rows > this->Rows)
+        this->Rows = rows;
+
+    memset(failed, 0, sizeof(failed));
+
+    for (int i = 0; i < rows; i++)
+    {
+        byte* row = &difference[i * TOOL_MAX_DUT];
+        bool any = false;
+
+        memset(lanes, 0, sizeof(lanes));
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            value = row[dut];
+
+            if (value == 0)
+                continue;
+
+            any = true;
+            this->SocketBits[dut] += CUtilities::PopCount(value);
+
+            for (int b = 0; b < 8; b++)
+            {
+                if (value & (1 << b))
+                    lanes[b][dut >> 6] |= (qword)1 << (dut & 63);
+            }
+        }
+
+        if (!any)
+            continue;
+
+        for (int b = 0; b < 8; b++)
+        {
+            for (int l = 0; l < HEATMAP_LANES; l++)
+            {
+                this->BitFails[i][b] += CUtilities::PopCount(lanes[b][l]);
+                failed[l] |= lanes[b][l];
+            }
+        }
+    }
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        this->SocketTested[dut]++;
+
+        if (failed[dut >> 6] & ((qword)1 << (dut & 63)))
+            this->SocketFails[dut]++;
+    }
+
+    this->Compares++;
+}
+
+/******************************************************************************
+    Name:   Add
+    Desc:   Same, from a bit-sliced diff (as filled by
+            SlicedImage::CompareMasked), which is already in DUT lanes
+******************************************************************************/
+void FailHeatmap::Add(SlicedImage& difference, word* listDut)
+{
+    DBGTrace("---> FailHeatmap::Add");
+
+    int dut;
+    qword lane;
+    DutLanes active, failed;
+    int rows = (difference.rows < HEATMAP_MAX_ROWS) ? difference.rows : HEATMAP_MAX_ROWS;
+
+    if (rows > this->Rows)
+        this->Rows = rows;
+
+    active.Set(listDut);
+
+    for (int i = 0; i < rows; i++)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            for (int l = 0; l < SLICE_LANES; l++)
+            {
+                lane = difference.Bits[i][b][l] & active.lane[l];
+
+                if (lane == 0)
+                    continue;
+
+                this->BitFails[i][b] += CUtilities::PopCount(lane);
+                failed.lane[l] |= lane;
+
+                for (; lane != 0; lane &= lane - 1)
+                    this->SocketBits[(l << 6) + CUtilities::CountTrailingZeros(lane)]++;
+            }
+        }
+    }
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        this->SocketTested[dut]++;
+
+        if (failed.Test(dut))
+            this->SocketFails[dut]++;
+    }
+
+    this->Compares++;
+}
+
+/******************************************************************************
+    Name:   GetBitFails
+    Desc:   Number of DUTs that have failed a register bit so far
+******************************************************************************/
+dword FailHeatmap::GetBitFails(int reg, int bit)
+{
+    if ((reg < 0) || (reg >= HEATMAP_MAX_ROWS) || (bit < 0) || (bit > 7))
+        return 0;
+
+    return this->BitFails[reg][bit];
+}
+
+/******************************************************************************
+    Name:   GetSocketFails
+    Desc:   Number of compares a socket (0 based) has failed
+******************************************************************************/
+dword FailHeatmap::GetSocketFails(int dut)
+{
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT))
+        return 0;
+
+    return this->SocketFails[dut];
+}
+
+/******************************************************************************
+    Name:   GetSocketBits
+    Desc:   Number of failing bits seen on a socket
+******************************************************************************/
+dword FailHeatmap::GetSocketBits(int dut)
+{
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT))
+        return 0;
+
+    return this->SocketBits[dut];
+}
+
+/******************************************************************************
+    Name:   GetSocketTested
+    Desc:   Number of compares a socket was part of
+******************************************************************************/
+dword FailHeatmap::GetSocketTested(int dut)
+{
+    if ((dut < 0) || (dut >= TOOL_MAX_DUT))
+        return 0;
+
+    return this->SocketTested[dut];
+}
+
+/******************************************************************************
+    Name:   Worst
+    Desc:   Fills reg and bit with up to count (register, bit) pairs that have
+            failed the most, worst first.  Returns the number found.
+******************************************************************************/
+int FailHeatmap::Worst(int* reg, int* bit, int count)
+{
+    int found = 0;
+    int pos;
+
+    for (int i = 0; i < this->Rows; i++)
+    {
+        for (int b = 0; b < 8; b++)
+        {
+            if (this->BitFails[i][b] == 0)
+                continue;
+
+            // insertion into the sorted list
+            pos = found;
+            while ((pos > 0) && (this->BitFails[reg[pos - 1]][bit[pos - 1]] < this->BitFails[i][b]))
+                pos--;
+
+            if (pos >= count)
+                continue;
+
+            for (int k = (found < count) ? found : count - 1; k > pos; k--)
+            {
+                reg[k] = reg[k - 1];
+                bit[k] = bit[k - 1];
+            }
+
+            reg[pos] = i;
+            bit[pos] = b;
+            if (found < count)
+                found++;
+        }
+    }
+
+    return found;
+}
+
+/******************************************************************************
+    Name:   PrintLine
+    Desc:   Appends a line to msg, printing msg first if it would not fit
+******************************************************************************/
+static void PrintLine(char* msg, const char* line)
+{
+    if (strlen(msg) + strlen(line) >= APP_MAX_CHAR_LONGER)
+    {
+        DBGVerbose(msg);
+        msg[0] = '\0';
+    }
+
+    strncat(msg, line, APP_MAX_CHAR_LONGER - 1 - strlen(msg));
+}
+
+/******************************************************************************
+    Name:   Print
+    Desc:   Prints the worst register bits and every failing socket
+******************************************************************************/
+void FailHeatmap::Print(int count)
+{
+    int reg[HEATMAP_MAX_ROWS * 8];
+    int bit[HEATMAP_MAX_ROWS * 8];
+    char msg[APP_MAX_CHAR_LONGER];
+    String temp;
+
+    if (count > HEATMAP_MAX_ROWS * 8)
+        count = HEATMAP_MAX_ROWS * 8;
+
+    int found = this->Worst(reg, bit, count);
+
+    // always display
+    bool was_on = DBGVerboseEnabled;
+    DBGVerboseEnabled = YES;
+
+    sprintf(msg, "\nFailHeatmap after %u compares:\n", this->Compares);
+
+    for (int i = 0; i < found; i++)
+    {
+        sprintf(temp, "Reg %02X bit %i: %u\n", reg[i], bit[i], this->BitFails[reg[i]][bit[i]]);
+        PrintLine(msg, temp);
+    }
+
+    for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+    {
+        if (this->SocketFails[dut] == 0)
+            continue;
+
+        sprintf(temp, "Dut %02d: %u/%u failed, %u bits\n", dut + 1,
+            this->SocketFails[dut], this->SocketTested[dut], this->SocketBits[dut]);
+        PrintLine(msg, temp);
+    }
+
+    DBGVerbose(msg);
+    DBGVerboseEnabled = was_on;
+}
+
+/******************************************************************************
+    Name:   Save
+    Desc:   Writes all counts to a csv file at the end of a lot
+******************************************************************************/
+int FailHeatmap::Save(char* filename)
+{
+    DBGTrace("---> FailHeatmap::Save");
+
+    FILE* file = fopen(filename, "w");
+
+    if (file == NULL)
+    {
+        String msg;
+        sprintf(msg, "FailHeatmap could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    fprintf(file, "compares,%u\n", this->Compares);
+
+    fprintf(file, "reg,bit,fails\n");
+    for (int i = 0; i < this->Rows; i++)
+    {
+        for (int b = 0; b < 8; b++)
+            fprintf(file, "%i,%i,%u\n", i, b, this->BitFails[i][b]);
+    }
+
+    fprintf(file, "dut,tested,fails,bits\n");
+    for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+    {
+        fprintf(file, "%i,%u,%u,%u\n", dut + 1,
+            this->SocketTested[dut], this->SocketFails[dut], this->SocketBits[dut]);
+    }
+
+    fclose(file);
+
+    return SUCCESS;
+}
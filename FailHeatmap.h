@@ -0,0 +1,52 @@
+/******************************************************************************
+
+    File:   FailHeatmap.h
+    Desc:   FailHeatmap keeps running fail counts across a lot from the XOR
+            diff matrices produced by the image compares, per (register, bit)
+            and per socket, so systematic bit failures and bad sockets show
+            up while the lot is still running.
+
+******************************************************************************/
+#ifndef _FAIL_HEATMAP_H_
+#define _FAIL_HEATMAP_H_
+
+#include "Defines.h"
+#include "Utilities.h"
+
+#define HEATMAP_LANES           ((TOOL_MAX_DUT + 63) / 64)
+#define HEATMAP_MAX_ROWS        ((NUM_RAM_REG > MAX_PAGE_SIZE) ? NUM_RAM_REG : MAX_PAGE_SIZE)
+
+struct SlicedImage;
+
+//-----------------------------------------------------------------------------
+//  FailHeatmap class definition
+class FailHeatmap
+{
+private:
+    dword BitFails[HEATMAP_MAX_ROWS][8]; // DUTs that failed each register bit
+    dword SocketFails[TOOL_MAX_DUT];    // compares where the socket failed
+    dword SocketBits[TOOL_MAX_DUT];     // failing bits seen on the socket
+    dword SocketTested[TOOL_MAX_DUT];   // compares the socket was part of
+    dword Compares;
+    int Rows;                           // highest row count seen
+
+public:
+    FailHeatmap(void);
+    ~FailHeatmap(void);
+
+    void Reset(void);
+    void Add(byte* difference, int rows, word* listDut);
+    void Add(SlicedImage& difference, word* listDut);
+
+    dword GetBitFails(int reg, int bit);
+    dword GetSocketFails(int dut);
+    dword GetSocketBits(int dut);
+    dword GetSocketTested(int dut);
+    dword GetCompares(void) { return this->Compares; }
+    int Worst(int* reg, int* bit, int count);
+
+    void Print(int count);
+    int Save(char* filename);
+};
+
+#endif
@@ -0,0 +1,192 @@
+/******************************************************************************
+
+    File:   FieldStats.cpp
+    Desc:   FieldStats keeps running statistics of decoded register values
+            per (field, DUT) in fixed memory.
+
+******************************************************************************/
+#include <math.h>
+
+#include "FieldStats.h"
+
+/******************************************************************************
+    Name:   FieldStats
+    Desc:   Default constructor
+******************************************************************************/
+FieldStats::FieldStats(void)
+{
+    this->Alpha = FIELDSTATS_DEFAULT_ALPHA;
+    this->Reset();
+}
+
+/******************************************************************************
+    Name:   ~FieldStats
+    Desc:   Default destructor
+******************************************************************************/
+FieldStats::~FieldStats(void)
+{
+}
+
+/******************************************************************************
+    Name:   Reset
+    Desc:   Clears all statistics at the start of a flow
+******************************************************************************/
+void FieldStats::Reset(void)
+{
+    memset(this->Mean, 0, sizeof(this->Mean));
+    memset(this->M2, 0, sizeof(this->M2));
+    memset(this->Min, 0, sizeof(this->Min));
+    memset(this->Max, 0, sizeof(this->Max));
+    memset(this->Ewma, 0, sizeof(this->Ewma));
+    memset(this->Last, 0, sizeof(this->Last));
+    memset(this->Count, 0, sizeof(this->Count));
+    this->Fields = 0;
+}
+
+/******************************************************************************
+    Name:   Update
+    Desc:   Adds one decoded image (converted[field][TOOL_MAX_DUT]) for the
+            DUTs in listDut.  Every lane is computed and lanes not in the
+            list are masked out, so the inner loops have no branches.
+            Counts are per field, so fields can be added by later updates.
+******************************************************************************/
+void FieldStats::Update(int (*converted)[TOOL_MAX_DUT], int fields, word* listDut)
+{
+    double active[TOOL_MAX_DUT];
+
+    if (fields > NUM_RAM_VALUES)
+        fields = NUM_RAM_VALUES;
+    if (fields > this->Fields)
+        this->Fields = fields;
+
+    memset(active, 0, sizeof(active));
+    for (int d = 0; listDut[d] != 0; d++)
+        active[listDut[d] - 1] = 1.0;
+
+    for (int f = 0; f < fields; f++)
+    {
+        const int* row = converted[f];
+        dword* count = this->Count[f];
+        double* mean = this->Mean[f];
+        double* m2 = this->M2[f];
+        double* low = this->Min[f];
+        double* high = this->Max[f];
+        double* ewma = this->Ewma[f];
+        double* last = this->Last[f];
+
+        for (int n = 0; n < TOOL_MAX_DUT; n++)
+        {
+            count[n] += (dword)active[n];
+
+            const double x = (double)row[n];
+            const double delta = x - mean[n];
+            const bool first = (active[n] != 0.0) && (count[n] == 1);
+            const double inverse = (active[n] != 0.0) ? 1.0 / count[n] : 0.0;   // 1/n, 0 if not active
+            const double alpha = active[n] * (first ? 1.0 : this->Alpha);      // EWMA weight, 1 on the first value
+
+            // Welford
+            mean[n] += delta * inverse;
+            m2[n] += active[n] * delta * (x - mean[n]);
+
+            // the first value seeds min and max
+            const double lo = first ? x : ((x < low[n]) ? x : low[n]);
+            const double hi = first ? x : ((x > high[n]) ? x : high[n]);
+            low[n] = (active[n] != 0.0) ? lo : low[n];
+            high[n] = (active[n] != 0.0) ? hi : high[n];
+
+            ewma[n] += alpha * (x - ewma[n]);
+            last[n] = (active[n] != 0.0) ? x : last[n];
+        }
+    }
+}
+
+/******************************************************************************
+    Name:   GetVariance
+    Desc:   Sample variance, 0 until a DUT has 2 values
+******************************************************************************/
+double FieldStats::GetVariance(int field, int dut)
+{
+    if (this->Count[field][dut] < 2)
+        return 0.0;
+
+    return this->M2[field][dut] / (this->Count[field][dut] - 1);
+}
+
+/******************************************************************************
+    Name:   GetStdDev
+    Desc:   Sample standard deviation
+******************************************************************************/
+double FieldStats::GetStdDev(int field, int dut)
+{
+    return sqrt(this->GetVariance(field, dut));
+}
+
+/******************************************************************************
+    Name:   Get
+    Desc:   Any statistic by field_stat
+******************************************************************************/
+double FieldStats::Get(field_stat stat, int field, int dut)
+{
+    switch (stat)
+    {
+        case STAT_MEAN:     return this->Mean[field][dut];
+        case STAT_STDDEV:   return this->GetStdDev(field, dut);
+        case STAT_MIN:      return this->Min[field][dut];
+        case STAT_MAX:      return this->Max[field][dut];
+        case STAT_RANGE:    return this->Max[field][dut] - this->Min[field][dut];
+        case STAT_EWMA:     return this->Ewma[field][dut];
+        case STAT_LAST:     return this->Last[field][dut];
+        default:
+            ERRLog(ERROR_UNDEFINED, "No such field_stat exists.");
+            return 0.0;
+    }
+}
+
+/******************************************************************************
+    Name:   Check
+    Desc:   Fails DUTs whose statistic is outside [low, high].  result is
+            only ever cleared, so several checks can share one array; DUTs
+            with no values yet are skipped.
+******************************************************************************/
+void FieldStats::Check(field_stat stat, int field, double low, double high, bool* result, word* listDut)
+{
+    int dut;
+    double value;
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+
+        if (this->Count[field][dut] == 0)
+            continue;
+
+        value = this->Get(stat, field, dut);
+        if ((value < low) || (value > high))
+            result[dut] = false;
+    }
+}
+
+/******************************************************************************
+    Name:   Print
+    Desc:   Prints the statistics of one field
+******************************************************************************/
+void FieldStats::Print(int field, word* listDut)
+{
+    int dut;
+    String msg;
+
+    // always display
+    bool was_on = DBGVerboseEnabled;
+    DBGVerboseEnabled = YES;
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        sprintf(msg, "\nFieldStats %i [%i]: n %u mean %.3f sd %.3f min %.0f max %.0f ewma %.3f", field, dut,
+            this->Count[field][dut], this->Mean[field][dut], this->GetStdDev(field, dut),
+            this->Min[field][dut], this->Max[field][dut], this->Ewma[field][dut]);
+        DBGVerbose(msg);
+    }
+
+    DBGVerboseEnabled = was_on;
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+
+    File:   FieldStats.h
+    Desc:   FieldStats keeps running statistics of decoded register values
+            (Image::Converted) per (field, DUT) across repeated reads and
+            temperature steps: Welford mean and variance, min, max and an
+            EWMA.  Memory is fixed, however many times a flow reads, and
+            each update is a branch-free pass over the DUT lanes.
+
+******************************************************************************/
+#ifndef _FIELD_STATS_H_
+#define _FIELD_STATS_H_
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+#define FIELDSTATS_DEFAULT_ALPHA    0.1
+
+// statistic used by Check
+enum field_stat { STAT_MEAN, STAT_STDDEV, STAT_MIN, STAT_MAX, STAT_RANGE, STAT_EWMA, STAT_LAST };
+
+//-----------------------------------------------------------------------------
+//  FieldStats class definition
+class FieldStats
+{
+private:
+    double Mean[NUM_RAM_VALUES][TOOL_MAX_DUT];
+    double M2[NUM_RAM_VALUES][TOOL_MAX_DUT];    // sum of squared differences from the mean
+    double Min[NUM_RAM_VALUES][TOOL_MAX_DUT];
+    double Max[NUM_RAM_VALUES][TOOL_MAX_DUT];
+    double Ewma[NUM_RAM_VALUES][TOOL_MAX_DUT];
+    double Last[NUM_RAM_VALUES][TOOL_MAX_DUT];
+    dword Count[NUM_RAM_VALUES][TOOL_MAX_DUT];  // values seen per field and DUT
+    double Alpha;
+    int Fields;                                 // highest field count seen
+
+public:
+    FieldStats(void);
+    ~FieldStats(void);
+
+    void Reset(void);
+    void SetAlpha(double alpha) { this->Alpha = alpha; }
+
+    void Update(int (*converted)[TOOL_MAX_DUT], int fields, word* listDut);
+    void Update(Image& img, int fields, word* listDut) { this->Update(img.Converted, fields, listDut); }
+
+    dword GetCount(int field, int dut) { return this->Count[field][dut]; }
+    double GetMean(int field, int dut) { return this->Mean[field][dut]; }
+    double GetVariance(int field, int dut);
+    double GetStdDev(int field, int dut);
+    double GetMin(int field, int dut) { return this->Min[field][dut]; }
+    double GetMax(int field, int dut) { return this->Max[field][dut]; }
+    double GetEwma(int field, int dut) { return this->Ewma[field][dut]; }
+    double Get(field_stat stat, int field, int dut);
+
+    void Check(field_stat stat, int field, double low, double high, bool* result, word* listDut);
+
+    void Print(int field, word* listDut);
+};
+
+#endif
@@ -0,0 +1,280 @@
+/******************************************************************************
+
+    File:   FusedPass.h
+    Desc:   One pass over Image::Raw for the usual verify step.  SetRaw,
+            CompareMaskedDefault and Convert each sweep every register row;
+            FusedPass does all three one row at a time, while the row is
+            still in cache.  The stages are picked by a compile-time policy,
+            and a disabled stage is an empty inline function, so no code is
+            generated for it.
+
+            Example:
+
+            static FieldDecoder decoder;    // once per program
+            decoder.Load(KRam::Table, KRam::COUNT);
+
+            FusedPass<FuseVerify>(img, raw, &spec, &decoder, diff, result, listDut);
+
+            Differences and results match CompareMaskedDefault; Converted
+            rows follow the field order of the map given to Load, and are 0
+            for DUTs not in listDut.  Nothing is printed, use PrintConverted
+            or B2SArray on the diff if needed.
+
+******************************************************************************/
+#ifndef _FUSED_PASS_H_
+#define _FUSED_PASS_H_
+
+#include <algorithm>
+
+#include "Defines.h"
+#include "Utilities.h"
+#include "RegisterTypeDefs.h"
+#include "RegisterMap.h"
+
+#define FUSE_MAX_SLICES         (NUM_RAM_VALUES * APP_MAX_ADDR)
+
+//-----------------------------------------------------------------------------
+//  stage policy
+template <bool WriteRaw, bool CompareSpec, bool DecodeFields>
+struct FusePolicy
+{
+    static const bool Write = WriteRaw;         // copy the new raw bytes in (SetRaw)
+    static const bool Compare = CompareSpec;    // masked compare to a Default
+    static const bool Decode = DecodeFields;    // fill Converted
+};
+
+typedef FusePolicy<true, true, true>    FuseVerify;
+typedef FusePolicy<true, true, false>   FuseWriteCompare;
+typedef FusePolicy<true, false, true>   FuseWriteDecode;
+typedef FusePolicy<false, true, true>   FuseCompareDecode;
+
+//-----------------------------------------------------------------------------
+//  the bits one register row contributes to one field
+typedef struct FieldSlice
+{
+    short           row;                // in Image::Raw
+    short           field;              // in Image::Converted
+    byte            mask;
+    byte            low;                // lowest bit of mask
+    byte            shift;              // position in the decoded value
+    byte            width;              // bits in the whole field
+    bool            contiguous;         // mask bits are adjacent
+    bool            first;              // first slice of the field, assigns
+    bool            last;               // last slice of the field
+    bool            sign;               // two's complement field
+
+    bool operator<(const FieldSlice& s) const { return row < s.row; }
+} FieldSlice;
+
+//-----------------------------------------------------------------------------
+//  slices of a register map, grouped by row (built once per program)
+typedef struct FieldDecoder
+{
+    FieldSlice      Slices[FUSE_MAX_SLICES];
+    int             RowStart[NUM_RAM_REG + 1];  // slices of row i are [RowStart[i], RowStart[i+1])
+    int             count;
+    int             fields;
+
+    FieldDecoder(void) : count(0), fields(0)
+    {
+        memset(RowStart, 0, sizeof(RowStart));
+    }
+
+    int Load(const RegField* t, int n)
+    {
+        DBGTrace("---> FieldDecoder::Load");
+
+        if (n > NUM_RAM_VALUES)
+        {
+            ERRLog(ERROR_INIT, "FieldDecoder map has more fields than NUM_RAM_VALUES.");
+            return ERROR_INIT;
+        }
+
+        count = 0;
+        fields = n;
+
+        for (int i = 0; i < n; i++)
+        {
+            for (int a = 0; a < t[i].num; a++)
+            {
+                FieldSlice& s = Slices[count++];
+                byte mask = t[i].mask[a];
+
+                s.row = (short)RegMapBytes(t, n, RegKey(t[i], a));
+                s.field = (short)i;
+                s.mask = mask;
+                s.low = (byte)CUtilities::CountTrailingZeros(mask);
+                s.shift = (byte)RegFieldBits(t[i], a);
+                s.width = (byte)RegFieldBits(t[i]);
+                s.contiguous = (((mask >> s.low) + 1) & (mask >> s.low)) == 0;
+                s.first = (a == 0);
+                s.last = false;
+                s.sign = (t[i].conversion == twos_comp);
+
+                if (s.row >= NUM_RAM_REG)
+                {
+                    ERRLog(ERROR_INIT, "FieldDecoder map has more bytes than NUM_RAM_REG.");
+                    count = 0;
+                    return ERROR_INIT;
+                }
+            }
+        }
+
+        // rows in order; a field is finished (and sign extended) at its
+        // highest row, so first has to be its lowest row
+        std::stable_sort(Slices, Slices + count);
+
+        for (int f = 0; f < n; f++)
+        {
+            int lo = -1, hi = -1;
+            for (int s = 0; s < count; s++)
+            {
+                if (Slices[s].field != f)
+                    continue;
+                Slices[s].first = false;
+                if (lo < 0)
+                    lo = s;
+                hi = s;
+            }
+            if (lo >= 0)
+            {
+                Slices[lo].first = true;
+                Slices[hi].last = true;
+            }
+        }
+
+        for (int r = 0, s = 0; r <= NUM_RAM_REG; r++)
+        {
+            while ((s < count) && (Slices[s].row < r))
+                s++;
+            RowStart[r] = s;
+        }
+
+        return SUCCESS;
+    }
+} FieldDecoder;
+
+//-----------------------------------------------------------------------------
+//  stage kernels, each works on one row for every DUT lane
+template <bool Enabled>
+struct FuseWrite
+{
+    static void Row(byte* row, const byte* raw_in, int r) { memcpy(row, &raw_in[r * TOOL_MAX_DUT], TOOL_MAX_DUT); }
+};
+
+template <>
+struct FuseWrite<false>
+{
+    static void Row(byte*, const byte*, int) {}
+};
+
+template <bool Enabled>
+struct FuseCompare
+{
+    static void Row(const byte* row, byte spec, byte mask, byte* diff, byte* fail, const byte* active)
+    {
+        const byte want = (byte)(spec & mask);
+
+        for (int n = 0; n < TOOL_MAX_DUT; n++)
+        {
+            byte bad = (byte)(((row[n] & mask) != want) & active[n]);
+            diff[n] = (byte)((row[n] ^ spec) & (0 - bad));
+            fail[n] |= bad;
+        }
+    }
+};
+
+template <>
+struct FuseCompare<false>
+{
+    static void Row(const byte*, byte, byte, byte*, byte*, const byte*) {}
+};
+
+template <bool Enabled>
+struct FuseDecode
+{
+    // every lane is decoded so the loop stays branch free, lanes not in
+    // active are then zeroed
+    static void Row(const FieldDecoder* decoder, int r, const byte* row, int (*converted)[TOOL_MAX_DUT],
+        const byte* active)
+    {
+        for (int k = decoder->RowStart[r]; k < decoder->RowStart[r + 1]; k++)
+        {
+            const FieldSlice& s = decoder->Slices[k];
+            int* out = converted[s.field];
+
+            for (int n = 0; n < TOOL_MAX_DUT; n++)
+            {
+                dword bits;
+
+                if (s.contiguous)
+                    bits = (dword)(row[n] & s.mask) >> s.low;
+                else
+                {
+                    bits = 0;
+                    for (int b = s.low, pos = 0; b < 8; b++)
+                    {
+                        if (s.mask & (1 << b))
+                            bits |= (dword)((row[n] >> b) & 1) << pos++;
+                    }
+                }
+
+                dword value = (s.first ? 0 : (dword)out[n]) | (bits << s.shift);
+
+                // sign extend two's complement values once complete
+                if (s.last && s.sign && (s.width < 32) && (value & (1u << (s.width - 1))))
+                    value |= ~((1u << s.width) - 1);
+
+                out[n] = (int)(value & (0 - (dword)active[n]));
+            }
+        }
+    }
+};
+
+template <>
+struct FuseDecode<false>
+{
+    static void Row(const FieldDecoder*, int, const byte*, int (*)[TOOL_MAX_DUT], const byte*) {}
+};
+
+//-----------------------------------------------------------------------------
+//  the fused pass
+//  raw_in is laid out like Image::Raw (only read with Policy::Write), spec
+//  is only used with Policy::Compare and decoder with Policy::Decode.
+//  difference (NUM_RAM_REG x TOOL_MAX_DUT) may be NULL.
+template <typename Policy>
+void FusedPass(Image& img, const byte* raw_in, Default* spec, const FieldDecoder* decoder,
+    byte* difference, bool* result, word* listDut)
+{
+    byte active[TOOL_MAX_DUT];
+    byte fail[TOOL_MAX_DUT];
+    byte scratch[TOOL_MAX_DUT];
+
+    memset(active, 0, sizeof(active));
+    memset(fail, 0, sizeof(fail));
+
+    for (int d = 0; listDut[d] != 0; d++)
+        active[listDut[d] - 1] = 1;
+
+    for (int i = 0; i < NUM_RAM_REG; i++)
+    {
+        byte* row = img.Raw[i];
+        byte* diff = (difference != NULL) ? &difference[i * TOOL_MAX_DUT] : scratch;
+
+        FuseWrite<Policy::Write>::Row(row, raw_in, i);
+        FuseCompare<Policy::Compare>::Row(row, spec ? spec->SpecImage[i] : 0, spec ? spec->Mask[i] : 0,
+            diff, fail, active);
+        FuseDecode<Policy::Decode>::Row(decoder, i, row, img.Converted, active);
+    }
+
+    if (Policy::Compare)
+    {
+        for (int n = 0; n < TOOL_MAX_DUT; n++)
+            result[n] = (fail[n] == 0);
+    }
+
+    if (Policy::Write)
+        img.MarkAllDirty();
+}
+
+#endif
@@ -0,0 +1,105 @@
+/******************************************************************************
+
+    File:   ImagePool.h
+    Desc:   Recycling pools for Image and VolImage.  Both are several KB per
+            object and the VolImage constructors clear every byte, so test
+            flows that take a snapshot per step should Acquire one from a
+            pool instead.  Recycled objects are not cleared again; callers
+            overwrite them with SetRaw anyway.
+
+******************************************************************************/
+#ifndef _IMAGE_POOL_H_
+#define _IMAGE_POOL_H_
+
+#include <vector>
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+//-----------------------------------------------------------------------------
+//  ObjectPool class
+template <typename T>
+class ObjectPool
+{
+private:
+    vector<T*> Free;
+    vector<T*> All;
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+public:
+    dword Created;
+    dword Reused;
+
+    ObjectPool(void) : Created(0), Reused(0) {}
+
+    ~ObjectPool(void)
+    {
+        for (size_t i = 0; i < All.size(); i++)
+            delete All[i];
+    }
+
+    // make sure count objects exist before the flow starts
+    void Reserve(int count)
+    {
+        while ((int)Free.size() < count)
+        {
+            T* obj = new T();
+            All.push_back(obj);
+            Free.push_back(obj);
+            Created++;
+        }
+    }
+
+    // returns a recycled object as it was left, or a new one
+    T* Acquire(void)
+    {
+        if (Free.empty())
+        {
+            T* obj = new T();
+            All.push_back(obj);
+            Created++;
+            return obj;
+        }
+
+        T* obj = Free.back();
+        Free.pop_back();
+        Reused++;
+        return obj;
+    }
+
+    void Release(T* obj)
+    {
+        if (obj != NULL)
+            Free.push_back(obj);
+    }
+
+    int Outstanding(void) { return (int)(All.size() - Free.size()); }
+};
+
+//-----------------------------------------------------------------------------
+//  Pooled class
+//  Acquires from a pool and releases back when it goes out of scope
+template <typename T>
+class Pooled
+{
+private:
+    ObjectPool<T>& Pool;
+    T* Obj;
+
+    Pooled(const Pooled&);
+    Pooled& operator=(const Pooled&);
+
+public:
+    Pooled(ObjectPool<T>& pool) : Pool(pool), Obj(pool.Acquire()) {}
+    ~Pooled(void) { Pool.Release(Obj); }
+
+    T* operator->(void) { return Obj; }
+    T& operator*(void) { return *Obj; }
+};
+
+typedef ObjectPool<Image>       ImagePool;
+typedef ObjectPool<VolImage>    VolImagePool;
+
+#endif
@@ -0,0 +1,168 @@
+/*******************************************************************************
+
+    File:   KAsync.cpp
+    Desc:   Single-threaded event loop function definitions for overlapping
+            chamber hardware waits on the SPEA x70 Ping-pong tester.
+
+*******************************************************************************/
+#include "KAsync.h"
+#include "KChamber.h"
+
+#define RELAY_SETTLE_MS         5.0
+
+/******************************************************************************
+    Name:   AsyncLoop
+    Desc:   Constructor, all hardware operations go through backend
+******************************************************************************/
+AsyncLoop::AsyncLoop(HwBackend *backend)
+{
+    this->Backend = backend;
+    this->RelaySettle = RELAY_SETTLE_MS;
+    this->RegSettle = 0;
+}
+
+/******************************************************************************
+    Name:   ~AsyncLoop
+    Desc:   Default destructor (tasks are owned by the caller)
+******************************************************************************/
+AsyncLoop::~AsyncLoop(void)
+{
+}
+
+/******************************************************************************
+    Name:   Spawn
+    Desc:   Adds a task to run on the next call to Run
+******************************************************************************/
+void AsyncLoop::Spawn(AsyncTask *task)
+{
+    task->Line = 0;
+    task->WakeAt = 0;
+    task->Status = SUCCESS;
+
+    this->Tasks.push_back(task);
+}
+
+/******************************************************************************
+    Name:   Run
+    Desc:   Resumes every task whose wait has expired until all tasks are
+            done.  When nothing is ready, waits on the backend until the
+            earliest task wakes up.
+******************************************************************************/
+void AsyncLoop::Run(void)
+{
+    DBGTrace("==> AsyncLoop::Run\n");
+
+    BOOL pending = TRUE;
+    BOOL ran;
+    DOUBLE now, next;
+
+    while (pending)
+    {
+        pending = FALSE;
+        ran = FALSE;
+        next = -1;
+        now = this->Backend->Now();
+
+        for (size_t t = 0; t < this->Tasks.size(); t++)
+        {
+            AsyncTask *task = this->Tasks[t];
+
+            if (task->IsDone())
+                continue;
+
+            if (task->WakeAt <= now)
+            {
+                task->Run(this);
+                ran = TRUE;
+            }
+
+            if (!task->IsDone())
+            {
+                pending = TRUE;
+                if ((next < 0) || (task->WakeAt < next))
+                    next = task->WakeAt;
+            }
+        }
+
+        if (pending && !ran)
+            this->Backend->Wait(next - now);
+    }
+
+    this->Tasks.clear();
+}
+
+/******************************************************************************
+    Name:   Suspend
+    Desc:   Records the result of an operation and when the task may resume
+******************************************************************************/
+void AsyncLoop::Suspend(AsyncTask *task, INT status, DOUBLE ms)
+{
+    task->Status = status;
+    task->WakeAt = this->Backend->Now() + ms;
+}
+
+/******************************************************************************
+    Name:   Switch
+    Desc:   Switches the active chamber, then waits for the relays to settle.
+            The chamber must use the same backend as the loop.
+******************************************************************************/
+void AsyncLoop::Switch(AsyncTask *task, Chamber *chamber)
+{
+    chamber->Switch();
+
+    this->Suspend(task, SUCCESS, this->RelaySettle);
+}
+
+/******************************************************************************
+    Name:   Relay
+    Desc:   Issues a single relay operation, keeping Chamber's cached
+            relay state in step, then waits for it to settle
+******************************************************************************/
+void AsyncLoop::Relay(AsyncTask *task, INT chamber, INT action)
+{
+    INT status = this->Backend->Relay(chamber, action);
+
+    Chamber::GetInstance()->UpdateRelayState(chamber, action, status);
+
+    this->Suspend(task, status, this->RelaySettle);
+}
+
+/******************************************************************************
+    Name:   Read
+    Desc:   Reads a register for every DUT in listDut
+******************************************************************************/
+void AsyncLoop::Read(AsyncTask *task, BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    INT status = this->Backend->ReadReg(page, addr, values, listDut);
+
+    this->Suspend(task, status, this->RegSettle);
+}
+
+/******************************************************************************
+    Name:   Write
+    Desc:   Writes a register for every DUT in listDut
+******************************************************************************/
+void AsyncLoop::Write(AsyncTask *task, BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    INT status = this->Backend->WriteReg(page, addr, values, listDut);
+
+    this->Suspend(task, status, this->RegSettle);
+}
+
+/******************************************************************************
+    Name:   Delay
+    Desc:   Suspends the task for ms without touching the hardware
+******************************************************************************/
+void AsyncLoop::Delay(AsyncTask *task, DOUBLE ms)
+{
+    this->Suspend(task, SUCCESS, ms);
+}
+
+/******************************************************************************
+    Name:   Yield
+    Desc:   Lets every other ready task run once before resuming
+******************************************************************************/
+void AsyncLoop::Yield(AsyncTask *task)
+{
+    this->Suspend(task, SUCCESS, 0);
+}
@@ -0,0 +1,92 @@
+/*******************************************************************************
+
+    File:   KAsync.h
+    Desc:   Single-threaded event loop for overlapping chamber hardware waits
+            on the SPEA x70 Ping-pong tester.  A test step is written as one
+            sequential Run() function that suspends at each ASYNC_AWAIT while
+            the relays or registers settle, and the loop runs the other
+            chamber's work in the meantime.
+
+            Tasks are resumable functions in the protothread style: Run() is
+            re-entered from the top and jumps back to the last await, so any
+            state that must survive an await has to be a member of the task,
+            not a local variable.
+
+            The Read and Write awaitables run on SimBackend and on a
+            replayed trace only.  SpeaBackend has no register path, so on
+            the tester they complete with ERROR_UNIMPLEMENTED; register
+            access there stays with the testplan's ASIC comms layer.
+
+*******************************************************************************/
+#ifndef _K_ASYNC_H_
+#define _K_ASYNC_H_
+
+#include <vector>
+
+#include "KDefines.h"
+#include "KHardware.h"
+
+class Chamber;
+class AsyncLoop;
+
+#define ASYNC_DONE              0
+#define ASYNC_PENDING           1
+
+#define ASYNC_BEGIN()           switch (this->Line) { case 0:
+#define ASYNC_AWAIT(op)         do { this->Line = __LINE__; op; return ASYNC_PENDING; case __LINE__:; } while (0)
+#define ASYNC_YIELD(loop)       ASYNC_AWAIT((loop)->Yield(this))
+#define ASYNC_END()             } this->Line = -1; return ASYNC_DONE
+
+//-----------------------------------------------------------------------------
+//  async task
+class AsyncTask
+{
+    friend class AsyncLoop;
+
+protected:
+    INT Line;                           // resume point, -1 when finished
+    DOUBLE WakeAt;                      // backend time the task may resume
+    INT Status;                         // result of the last awaited op
+
+public:
+    AsyncTask(void) : Line(0), WakeAt(0), Status(SUCCESS) {}
+    virtual ~AsyncTask(void) {}
+
+    virtual INT Run(AsyncLoop *loop) = 0;
+
+    BOOL IsDone(void) { return (this->Line == -1); }
+    INT GetStatus(void) { return this->Status; }
+};
+
+//-----------------------------------------------------------------------------
+//  async event loop
+class AsyncLoop
+{
+private:
+    HwBackend *Backend;
+    std::vector<AsyncTask*> Tasks;
+
+    void Suspend(AsyncTask *task, INT status, DOUBLE ms);
+
+public:
+    DOUBLE RelaySettle;                 // ms to wait after a relay operation
+    DOUBLE RegSettle;                   // ms to wait after a register access
+
+    AsyncLoop(HwBackend *backend);
+    ~AsyncLoop(void);
+
+    HwBackend *GetBackend(void) { return this->Backend; }
+
+    void Spawn(AsyncTask *task);
+    void Run(void);
+
+    // awaitables, use inside ASYNC_AWAIT
+    void Switch(AsyncTask *task, Chamber *chamber);
+    void Relay(AsyncTask *task, INT chamber, INT action);
+    void Read(AsyncTask *task, BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    void Write(AsyncTask *task, BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    void Delay(AsyncTask *task, DOUBLE ms);
+    void Yield(AsyncTask *task);
+};
+
+#endif
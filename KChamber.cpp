@@ -17,11 +17,18 @@ Chamber *Chamber::Instance = NULL;
 ******************************************************************************/
 Chamber::Chamber(void)
 {
+    this->Backend = SpeaBackend::GetInstance();
+    this->ResetTiming();
+    this->InvalidateRelays();
+    this->RelaysIssued = 0;
+    this->RelaysSkipped = 0;
+    
     // initialize to CHAMBER_1 to start
     this->CurrChamber = CHAMBER_1;
-    this->SetChamber(this->CurrChamber);
+    this->TimedSetChamber(this->CurrChamber);
     
-    memset(this->DutList, 0, sizeof(this->DutList));
+    this->DutList[CHAMBER_1].Clear();
+    this->DutList[CHAMBER_2].Clear();
     memset(this->SNList, 0, sizeof(this->SNList));
 }
 
@@ -55,12 +62,22 @@ void Chamber::Begin(void)
 {
     DBGTrace("==> Chamber::Begin\n");
     
+    // utilization is per lot
+    this->ResetTiming();
+    this->Mark(PHASE_BEGIN);
+    this->RelaysIssued = 0;
+    this->RelaysSkipped = 0;
+    
     // initialize to CHAMBER_1 to start
     this->CurrChamber = CHAMBER_1;
-    this->SetChamber(this->CurrChamber);
+    this->TimedSetChamber(this->CurrChamber);
     
-    memset(this->DutList, 0, sizeof(this->DutList));
+    this->DutList[CHAMBER_1].Clear();
+    this->DutList[CHAMBER_2].Clear();
     memset(this->SNList, 0, sizeof(this->SNList));
+    
+    // every site gets tested again on a new insertion
+    CError::ClearMask();
 }
 
 /******************************************************************************
@@ -71,9 +88,18 @@ void Chamber::End(void)
 {
     DBGTrace("==> Chamber::End\n");
     
+    DOUBLE start = this->Mark(PHASE_END);
+    this->CloseActive(start);
+    
     // SPEA Hardware calls
-    DxMtx110ManageV2 ( CHAMBER_1, OPEN );
-    DxMtx110ManageV2 ( CHAMBER_2, OPEN );
+    this->SetRelays ( OPEN, OPEN );
+    
+    // both chambers wait on the relays here
+    DOUBLE span = this->Backend->Now() - start;
+    this->Timing[CHAMBER_1].switching += span;
+    this->Timing[CHAMBER_2].switching += span;
+    
+    this->PrintUtilization();
 }
 
 /******************************************************************************
@@ -90,18 +116,196 @@ INT Chamber::GetChamber(void)
 /******************************************************************************
     Name:   SetChamber
     Desc:   Actually does the hardware calls to change the active chamber
-            DxMtx110ManageV2 is located in Testplan.cpp
+            through the backend (DxMtx110ManageV2 on the real tester)
             Chamber(1 or 2), Action(OPEN,CLOSE)
 ******************************************************************************/
 void Chamber::SetChamber(INT chamber)
 {
     DBGTrace("==> Chamber::SetChamber\n");
     
-    INT otherchamber = 1 - chamber;
-    
     // SPEA Hardware calls
-    DxMtx110ManageV2 ( otherchamber, OPEN );
-    DxMtx110ManageV2 ( chamber, CLOSE );
+    if (chamber == CHAMBER_1)
+        this->SetRelays ( CLOSE, OPEN );
+    else
+        this->SetRelays ( OPEN, CLOSE );
+}
+
+/******************************************************************************
+    Name:   SetRelays
+    Desc:   Brings both chamber relays to the wanted state, sending only the
+            operations that change something, opens before closes so both
+            chambers are never connected at once
+******************************************************************************/
+INT Chamber::SetRelays(INT action1, INT action2)
+{
+    INT wanted[2] = { action1, action2 };
+    INT order[2] = { OPEN, CLOSE };
+    INT chambers[2];
+    INT actions[2];
+    INT count = 0;
+    
+    for (INT i = 0; i < 2; i++)
+    {
+        for (INT c = CHAMBER_1; c <= CHAMBER_2; c++)
+        {
+            if (wanted[c] != order[i])
+                continue;
+            
+            if (this->RelayState[c] == wanted[c])
+            {
+                this->RelaysSkipped++;
+                continue;
+            }
+            
+            chambers[count] = c;
+            actions[count] = wanted[c];
+            count++;
+        }
+    }
+    
+    if (count == 0)
+        return SUCCESS;
+    
+    INT status = this->Backend->RelayBatch(count, chambers, actions);
+    this->RelaysIssued += count;
+    
+    for (INT i = 0; i < count; i++)
+        this->UpdateRelayState(chambers[i], actions[i], status);
+    
+    return status;
+}
+
+/******************************************************************************
+    Name:   InvalidateRelays
+    Desc:   Forgets the cached relay state, so the next SetChamber or End
+            sends every operation again
+******************************************************************************/
+void Chamber::InvalidateRelays(void)
+{
+    this->RelayState[CHAMBER_1] = RELAY_UNKNOWN;
+    this->RelayState[CHAMBER_2] = RELAY_UNKNOWN;
+}
+
+/******************************************************************************
+    Name:   UpdateRelayState
+    Desc:   Caches the result of a relay operation; after a failure the
+            matrix state is not known
+******************************************************************************/
+void Chamber::UpdateRelayState(INT chamber, INT action, INT status)
+{
+    if ((chamber < CHAMBER_1) || (chamber > CHAMBER_2))
+        return;
+    
+    this->RelayState[chamber] = (status == SUCCESS) ? action : RELAY_UNKNOWN;
+}
+
+/******************************************************************************
+    Name:   GetRelayState
+    Desc:   Returns the cached relay state of a chamber
+******************************************************************************/
+INT Chamber::GetRelayState(INT chamber)
+{
+    return this->RelayState[chamber];
+}
+
+/******************************************************************************
+    Name:   GetRelaysIssued
+    Desc:   Returns the relay operations sent to the backend since Begin
+******************************************************************************/
+DWORD Chamber::GetRelaysIssued(void)
+{
+    return this->RelaysIssued;
+}
+
+/******************************************************************************
+    Name:   GetRelaysSkipped
+    Desc:   Returns the relay operations avoided by the cache since Begin
+******************************************************************************/
+DWORD Chamber::GetRelaysSkipped(void)
+{
+    return this->RelaysSkipped;
+}
+
+/******************************************************************************
+    Name:   TimedSetChamber
+    Desc:   SetChamber, charging the relay time to the chamber being made
+            active (the other one idles) and starting its next cycle
+******************************************************************************/
+void Chamber::TimedSetChamber(INT chamber)
+{
+    DOUBLE start = this->Backend->Now();
+    
+    this->SetChamber(chamber);
+    
+    DOUBLE now = this->Backend->Now();
+    ChamberTiming &t = this->Timing[chamber];
+    
+    t.switching += now - start;
+    this->Timing[1 - chamber].idle += now - start;
+    
+    // busy share of the cycle since it was last made active
+    if ((t.cycles > 0) && (now > t.cycleStart))
+    {
+        DOUBLE share = (t.busy - t.cycleBusy) / (now - t.cycleStart);
+        
+        if (t.cycles == 1)
+            t.utilization = share;
+        else
+            t.utilization += CHAMBER_UTIL_ALPHA * (share - t.utilization);
+    }
+    
+    t.cycles++;
+    t.cycleStart = now;
+    t.cycleBusy = t.busy;
+    
+    this->ActiveStart = now;
+    this->ActiveHost = 0;
+}
+
+/******************************************************************************
+    Name:   CloseActive
+    Desc:   Charges the time since the active chamber's relays settled: busy
+            (less the host time already charged) to it, idle to the other
+******************************************************************************/
+void Chamber::CloseActive(DOUBLE now)
+{
+    INT chamber = this->CurrChamber;
+    DOUBLE span = now - this->ActiveStart;
+    
+    this->Timing[chamber].busy += span - this->ActiveHost;
+    this->Timing[1 - chamber].idle += span;
+    
+    this->ActiveStart = now;
+    this->ActiveHost = 0;
+}
+
+/******************************************************************************
+    Name:   Mark
+    Desc:   Timestamps a phase transition, returns the time
+******************************************************************************/
+DOUBLE Chamber::Mark(chamber_phase phase)
+{
+    DOUBLE now = this->Backend->Now();
+    
+    this->PhaseStamp[phase] = now;
+    this->PhaseCount[phase]++;
+    
+    return now;
+}
+
+/******************************************************************************
+    Name:   ResetTiming
+    Desc:   Clears the time accounting and starts it from now
+******************************************************************************/
+void Chamber::ResetTiming(void)
+{
+    memset(this->Timing, 0, sizeof(this->Timing));
+    memset(this->PhaseStamp, 0, sizeof(this->PhaseStamp));
+    memset(this->PhaseCount, 0, sizeof(this->PhaseCount));
+    
+    this->LotStart = this->Backend->Now();
+    this->ActiveStart = this->LotStart;
+    this->ActiveHost = 0;
 }
 
 /******************************************************************************
@@ -123,9 +327,11 @@ void Chamber::Switch(void)
 {
     DBGTrace("==> Chamber::Switch\n");
     
+    this->CloseActive(this->Mark(PHASE_SWITCH));
+    
     this->Toggle();
     
-    this->SetChamber(this->CurrChamber);
+    this->TimedSetChamber(this->CurrChamber);
     
     // debug
     //this->PrintChamber();
@@ -139,17 +345,22 @@ void Chamber::SetSNList(QWORD *currSN)
 {
     DBGTrace("==> Chamber::SetSNList\n");
     
+    DOUBLE start = this->Mark(PHASE_SN_READ);
     INT dut;
     
     // get active chamber
     INT chamber = this->CurrChamber;
     
     // save SN
-    for (INT d = 0; this->DutList[chamber][d] != 0; d++)
+    for (INT d = 0; d < this->DutList[chamber].Size(); d++)
     {
         dut = this->DutList[chamber][d] - 1;
         this->SNList[dut] = currSN[dut];
     }
+    
+    DOUBLE span = this->Backend->Now() - start;
+    this->Timing[chamber].host += span;
+    this->ActiveHost += span;
 }
 
 /******************************************************************************
@@ -161,13 +372,14 @@ void Chamber::SNCheck(QWORD *currSN, DOUBLE *ValidList)
 {
     DBGTrace("==> Chamber::SNCheck\n");
     
+    DOUBLE start = this->Mark(PHASE_SN_CHECK);
     INT dut;
     
     // get active chamber
     INT chamber = this->CurrChamber;
     
     // compare to correct SNs
-    for (INT d = 0; this->DutList[chamber][d] != 0; d++)
+    for (INT d = 0; d < this->DutList[chamber].Size(); d++)
     {
         dut = this->DutList[chamber][d] - 1;
         
@@ -179,6 +391,10 @@ void Chamber::SNCheck(QWORD *currSN, DOUBLE *ValidList)
         else
             ValidList[dut] = FALSE;
     }
+    
+    DOUBLE span = this->Backend->Now() - start;
+    this->Timing[chamber].host += span;
+    this->ActiveHost += span;
 }
 
 /******************************************************************************
@@ -209,7 +425,32 @@ void Chamber::SNCombineArray(DOUBLE *TestDataArray, DOUBLE *Array)
 ******************************************************************************/
 WORD* Chamber::GetDutList(void)
 {
-    return this->DutList[this->CurrChamber];
+    return this->DutList[this->CurrChamber].Data();
+}
+
+/******************************************************************************
+    Name:   GetBackend
+    Desc:   Returns the backend used for hardware calls
+******************************************************************************/
+HwBackend* Chamber::GetBackend(void)
+{
+    return this->Backend;
+}
+
+/******************************************************************************
+    Name:   SetBackend
+    Desc:   Routes hardware calls to a different backend (e.g. SimBackend
+            when running without a tester).  Does not touch the relays, but
+            forgets their state and restarts the time accounting, since the
+            new backend has its own relays and clock.
+******************************************************************************/
+void Chamber::SetBackend(HwBackend *backend)
+{
+    DBGTrace("==> Chamber::SetBackend\n");
+    
+    this->Backend = backend;
+    this->InvalidateRelays();
+    this->ResetTiming();
 }
 
 /******************************************************************************
@@ -220,28 +461,52 @@ void Chamber::UpdateDutList(WORD *listDut)
 {
     //DBGTrace("==> Chamber::UpdateDutList\n");
     
-    memset(this->DutList, 0, sizeof(this->DutList));
+    INT dropped[2] = { 0, 0 };
     
-    INT a = 0, b = 0;
+    this->DutList[CHAMBER_1].Clear();
+    this->DutList[CHAMBER_2].Clear();
     
     for (INT d = 0; listDut[d] != 0; d++)
     {
-        if( IsOdd(listDut[d]) )
-        {
-            this->DutList[CHAMBER_1][a] = listDut[d];
-            a++;
-        }
-        else
+        // skip sites masked out by a hardware error
+        if ( CError::IsMasked(listDut[d] - 1) )
+            continue;
+        
+        INT chamber = IsOdd(listDut[d]) ? CHAMBER_1 : CHAMBER_2;
+        
+        // a full chamber means the die list has more sites than the tester
+        if ( !this->DutList[chamber].Push(listDut[d]) )
+            dropped[chamber]++;
+    }
+    
+    for (INT chamber = CHAMBER_1; chamber <= CHAMBER_2; chamber++)
+    {
+        if (dropped[chamber] > 0)
         {
-            this->DutList[CHAMBER_2][b] = listDut[d];
-            b++;
+            String msg;
+            sprintf(msg, "Chamber %i DUT list is full, %i sites were left out.", chamber + 1, dropped[chamber]);
+            ERRLog(ERROR_SPEC, msg);
         }
-        
-        if (d > 70)
-            break;
     }
 }
 
+/******************************************************************************
+    Name:   CheckChamber
+    Desc:   Checks a status from a hardware call that covers the whole active
+            chamber.  With CError isolation on, a failure masks out only this
+            chamber's sites instead of aborting both.
+******************************************************************************/
+void Chamber::CheckChamber(INT status, CHAR *msg)
+{
+    if (status == SUCCESS)
+        return;
+    
+    CError::CheckSites(status, msg, this->DutList[this->CurrChamber].Data());
+    
+    // drop masked sites from the active list right away
+    this->DutList[this->CurrChamber].RemoveIf([](WORD dut) { return CError::IsMasked(dut - 1); });
+}
+
 /******************************************************************************
     Name:   IsOdd
     Desc:   Checks if a DUT is odd
@@ -316,3 +581,99 @@ void Chamber::PrintSNList(void)
     // print out debug
     DBGPrint(msg);
 }
+
+/******************************************************************************
+    Name:   GetTiming
+    Desc:   Returns the time accounting for a chamber, as of its last phase
+            transition
+******************************************************************************/
+const ChamberTiming* Chamber::GetTiming(INT chamber)
+{
+    return &this->Timing[chamber];
+}
+
+/******************************************************************************
+    Name:   GetUtilization
+    Desc:   Rolling busy share of a ping-pong cycle, or the share of the lot
+            so far until the chamber has been through a full cycle
+******************************************************************************/
+DOUBLE Chamber::GetUtilization(INT chamber)
+{
+    if (this->Timing[chamber].cycles > 1)
+        return this->Timing[chamber].utilization;
+    
+    DOUBLE elapsed = this->GetElapsed();
+    
+    return (elapsed > 0) ? (this->Timing[chamber].busy / elapsed) : 0;
+}
+
+/******************************************************************************
+    Name:   GetElapsed
+    Desc:   Returns ms since Begin (or since the backend was set)
+******************************************************************************/
+DOUBLE Chamber::GetElapsed(void)
+{
+    return this->Backend->Now() - this->LotStart;
+}
+
+/******************************************************************************
+    Name:   GetPhaseStamp
+    Desc:   Returns the time of the last transition into a phase
+******************************************************************************/
+DOUBLE Chamber::GetPhaseStamp(chamber_phase phase)
+{
+    return this->PhaseStamp[phase];
+}
+
+/******************************************************************************
+    Name:   GetPhaseCount
+    Desc:   Returns how many times a phase was entered since Begin
+******************************************************************************/
+DWORD Chamber::GetPhaseCount(chamber_phase phase)
+{
+    return this->PhaseCount[phase];
+}
+
+/******************************************************************************
+    Name:   PrintUtilization
+    Desc:   Prints the per chamber time accounting, called from End as the
+            end-of-lot summary.  Always displayed, like the other summaries.
+******************************************************************************/
+void Chamber::PrintUtilization(void)
+{
+    DBGTrace("==> Chamber::PrintUtilization\n");
+    
+    CHAR tmp[APP_MAX_CHAR];
+    CHAR msg[4096];
+    DOUBLE elapsed = this->GetElapsed();
+    
+    // init string
+    memset(msg, '\0', sizeof(msg));
+    
+    sprintf(tmp, "Chamber utilization over %.1f ms, %u switches, %u SN reads, %u SN checks",
+        elapsed, this->PhaseCount[PHASE_SWITCH], this->PhaseCount[PHASE_SN_READ],
+        this->PhaseCount[PHASE_SN_CHECK]);
+    strcat(tmp, APP_NEWLINE);
+    strcat(msg, tmp);
+    
+    for (INT chamber = CHAMBER_1; chamber <= CHAMBER_2; chamber++)
+    {
+        ChamberTiming &t = this->Timing[chamber];
+        
+        sprintf(tmp, "Chamber %i: busy %.1f host %.1f idle %.1f switch %.1f ms, utilization %.1f%% (rolling %.1f%%)",
+            chamber + 1, t.busy, t.host, t.idle, t.switching,
+            (elapsed > 0) ? (100.0 * t.busy / elapsed) : 0.0, 100.0 * this->GetUtilization(chamber));
+        strcat(tmp, APP_NEWLINE);
+        strcat(msg, tmp);
+    }
+    
+    sprintf(tmp, "Relays: %u operations sent, %u skipped", this->RelaysIssued, this->RelaysSkipped);
+    strcat(tmp, APP_NEWLINE);
+    strcat(msg, tmp);
+    
+    // always display
+    bool was_on = DBGVerboseEnabled;
+    DBGVerboseEnabled = YES;
+    DBGVerbose(msg);
+    DBGVerboseEnabled = was_on;
+}
\ No newline at end of file
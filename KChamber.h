@@ -5,12 +5,44 @@
             Each chamber contains 35 sockets, and this class controls any 
             necessary functionality pertaining to having 2 chambers (such as
             switching between chambers, gettin SNs, checking SNs, etc).
+
+            Chamber also timestamps its phases on the backend clock and
+            keeps, per chamber, the time spent testing (busy), in the SN
+            calls (host), waiting for the other chamber (idle) and switching
+            relays.  For each chamber busy + host + idle + switch adds up to
+            the time since Begin.
+
+            The relay matrix state is cached, so only the relay operations
+            that change something are sent, together as one batch.  Relay
+            operations sent without going through Chamber (AsyncLoop::Relay)
+            report back through UpdateRelayState.
   
 *******************************************************************************/
 #ifndef _K_CHAMBER_H_
 #define _K_CHAMBER_H_
 
 #include "KDefines.h"
+#include "KHardware.h"
+#include "SmallVec.h"
+
+#define CHAMBER_UTIL_ALPHA      0.2     // weight of the newest cycle in the rolling utilization
+#define RELAY_UNKNOWN           -1      // relay state before the first operation
+
+enum chamber_phase { PHASE_BEGIN, PHASE_SWITCH, PHASE_SN_READ, PHASE_SN_CHECK, PHASE_END, NUM_PHASES };
+
+//-----------------------------------------------------------------------------
+//  time accounting for one chamber, in ms of backend time
+typedef struct ChamberTiming
+{
+    DOUBLE          busy;               // active and testing
+    DOUBLE          host;               // active, in SetSNList/SNCheck
+    DOUBLE          idle;               // waiting while the other one tests
+    DOUBLE          switching;          // relays settling to make it active
+    DOUBLE          utilization;        // rolling busy share of a ping-pong cycle
+    DWORD           cycles;             // times it was made active
+    DOUBLE          cycleStart;         // when it was last made active
+    DOUBLE          cycleBusy;          // busy at that time
+} ChamberTiming;
 
 //-----------------------------------------------------------------------------
 //  chamber class
@@ -18,13 +50,30 @@ class Chamber
 {
 private:
     INT CurrChamber;
-    WORD DutList[2][APP_HALF_DUT + 1];
+    HwBackend *Backend;
+    SmallVec<WORD, APP_HALF_DUT> DutList[2];
     QWORD SNList[APP_MAX_DUT];
     
+    INT RelayState[2];                  // OPEN, CLOSE or RELAY_UNKNOWN
+    DWORD RelaysIssued;
+    DWORD RelaysSkipped;
+    
+    ChamberTiming Timing[2];
+    DOUBLE LotStart;
+    DOUBLE ActiveStart;                 // when the active chamber's relays settled
+    DOUBLE ActiveHost;                  // host time since then
+    DOUBLE PhaseStamp[NUM_PHASES];
+    DWORD PhaseCount[NUM_PHASES];
+    
     Chamber(void);
     static Chamber *Instance;
     
     void SetChamber(INT chamber);
+    INT SetRelays(INT action1, INT action2);
+    DOUBLE Mark(chamber_phase phase);
+    void ResetTiming(void);
+    void CloseActive(DOUBLE now);
+    void TimedSetChamber(INT chamber);
     void Toggle(void);
     BOOL IsOdd(WORD dut);
 
@@ -41,9 +90,25 @@ public:
     void SNCheck(QWORD *currSN, DOUBLE *ValidList);
     void SNCombineArray(DOUBLE *TestDataArray, DOUBLE *Array);
     WORD* GetDutList(void);
+    HwBackend* GetBackend(void);
+    void SetBackend(HwBackend *backend);
     void UpdateDutList(WORD *listDut);
+    void CheckChamber(INT status, CHAR *msg);
     void PrintChamber(void);
     void PrintSNList(void);
+    
+    void InvalidateRelays(void);
+    void UpdateRelayState(INT chamber, INT action, INT status);
+    INT GetRelayState(INT chamber);
+    DWORD GetRelaysIssued(void);
+    DWORD GetRelaysSkipped(void);
+    
+    const ChamberTiming* GetTiming(INT chamber);
+    DOUBLE GetUtilization(INT chamber);
+    DOUBLE GetElapsed(void);
+    DOUBLE GetPhaseStamp(chamber_phase phase);
+    DWORD GetPhaseCount(chamber_phase phase);
+    void PrintUtilization(void);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,729 @@
+/*******************************************************************************
+
+    File:   KHardware.cpp
+    Desc:   Hardware backend function definitions for the SPEA x70 Ping-pong
+            tester.  SpeaBackend makes the real relay matrix calls, and
+            SimBackend stands in for the tester when there is no hardware.
+            RecordBackend and ReplayBackend write and play back traces of
+            the calls made to either.
+
+*******************************************************************************/
+#include <chrono>
+#include <thread>
+
+#include "KHardware.h"
+#include "Utilities.h"
+
+SpeaBackend *SpeaBackend::Instance = NULL;
+
+/******************************************************************************
+    Name:   RelayBatch
+    Desc:   Issues several relay operations in order, stopping at the first
+            failure.  Backends with a batch command override this; the
+            others (including the SPEA matrix, whose DxMtx110ManageV2 takes
+            one chamber at a time) send them one by one.
+******************************************************************************/
+INT HwBackend::RelayBatch(INT count, INT *chambers, INT *actions)
+{
+    INT status;
+
+    for (INT i = 0; i < count; i++)
+    {
+        status = this->Relay(chambers[i], actions[i]);
+        if (status != SUCCESS)
+            return status;
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   SpeaBackend
+    Desc:   Default constructor
+******************************************************************************/
+SpeaBackend::SpeaBackend(void)
+{
+    this->Start = this->Clock();
+}
+
+/******************************************************************************
+    Name:   GetInstance
+    Desc:   Returns/creates singleton instance (there is only one matrix)
+******************************************************************************/
+SpeaBackend *SpeaBackend::GetInstance(void)
+{
+    if (SpeaBackend::Instance == NULL)
+        SpeaBackend::Instance = new SpeaBackend();
+    
+    return SpeaBackend::Instance;
+}
+
+/******************************************************************************
+    Name:   Clock
+    Desc:   Monotonic wall clock in ms
+******************************************************************************/
+DOUBLE SpeaBackend::Clock(void)
+{
+    using namespace std::chrono;
+
+    return duration<DOUBLE, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+/******************************************************************************
+    Name:   Relay
+    Desc:   DxMtx110ManageV2 is located in Testplan.cpp
+            Chamber(1 or 2), Action(OPEN,CLOSE)
+******************************************************************************/
+INT SpeaBackend::Relay(INT chamber, INT action)
+{
+    // SPEA Hardware calls
+    DxMtx110ManageV2 ( chamber, action );
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   ReadReg
+    Desc:   Not available: on the tester registers are accessed by the ASIC
+            comms layer in the testplan, which the chamber backend does not
+            wrap.  Register awaitables only run on SimBackend or a replay.
+******************************************************************************/
+INT SpeaBackend::ReadReg(BYTE, BYTE, BYTE *, WORD *)
+{
+    return ERROR_UNIMPLEMENTED;
+}
+
+/******************************************************************************
+    Name:   WriteReg
+    Desc:   See ReadReg
+******************************************************************************/
+INT SpeaBackend::WriteReg(BYTE, BYTE, BYTE *, WORD *)
+{
+    return ERROR_UNIMPLEMENTED;
+}
+
+/******************************************************************************
+    Name:   Now
+    Desc:   Returns ms since the backend was created
+******************************************************************************/
+DOUBLE SpeaBackend::Now(void)
+{
+    return this->Clock() - this->Start;
+}
+
+/******************************************************************************
+    Name:   Wait
+    Desc:   Blocks the test thread for the given number of ms
+******************************************************************************/
+void SpeaBackend::Wait(DOUBLE ms)
+{
+    if (ms > 0)
+        std::this_thread::sleep_for(std::chrono::duration<DOUBLE, std::milli>(ms));
+}
+
+/******************************************************************************
+    Name:   SimBackend
+    Desc:   Default constructor
+******************************************************************************/
+SimBackend::SimBackend(void)
+{
+    this->RelayTime = 1.0;
+    this->RegTime = 0.1;
+
+    this->Reset();
+}
+
+/******************************************************************************
+    Name:   Reset
+    Desc:   Opens both chambers, clears all registers and restarts the clock
+******************************************************************************/
+void SimBackend::Reset(void)
+{
+    this->Clock = 0;
+    this->RelayOps = 0;
+    this->RegOps = 0;
+    this->RelayState[CHAMBER_1] = OPEN;
+    this->RelayState[CHAMBER_2] = OPEN;
+
+    memset(this->Regs, 0, sizeof(this->Regs));
+}
+
+/******************************************************************************
+    Name:   Relay
+    Desc:   Sets the simulated relay state for a chamber
+******************************************************************************/
+INT SimBackend::Relay(INT chamber, INT action)
+{
+    if ((chamber != CHAMBER_1) && (chamber != CHAMBER_2))
+        return ERROR_HARDWARE;
+
+    this->RelayState[chamber] = action;
+    this->RelayOps++;
+    this->Clock += this->RelayTime;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   ReadReg
+    Desc:   Reads one simulated register for every DUT in listDut
+******************************************************************************/
+INT SimBackend::ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    if (page >= SIM_MAX_PAGES)
+        return ERROR_HARDWARE;
+
+    INT dut;
+
+    for (INT d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        values[dut] = this->Regs[page][addr][dut];
+    }
+
+    this->RegOps++;
+    this->Clock += this->RegTime;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   WriteReg
+    Desc:   Writes one simulated register for every DUT in listDut
+******************************************************************************/
+INT SimBackend::WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    if (page >= SIM_MAX_PAGES)
+        return ERROR_HARDWARE;
+
+    INT dut;
+
+    for (INT d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        this->Regs[page][addr][dut] = values[dut];
+    }
+
+    this->RegOps++;
+    this->Clock += this->RegTime;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Now
+    Desc:   Returns the virtual time in ms
+******************************************************************************/
+DOUBLE SimBackend::Now(void)
+{
+    return this->Clock;
+}
+
+/******************************************************************************
+    Name:   Wait
+    Desc:   Advances the virtual clock instead of sleeping
+******************************************************************************/
+void SimBackend::Wait(DOUBLE ms)
+{
+    if (ms > 0)
+        this->Clock += ms;
+}
+
+/******************************************************************************
+    Name:   GetRelay
+    Desc:   Returns the simulated relay state for a chamber
+******************************************************************************/
+INT SimBackend::GetRelay(INT chamber)
+{
+    return this->RelayState[chamber];
+}
+
+/******************************************************************************
+    Name:   RecordBackend
+    Desc:   Constructor, inner is the backend that does the real work
+******************************************************************************/
+RecordBackend::RecordBackend(HwBackend *inner)
+{
+    this->Inner = inner;
+    this->File = NULL;
+    this->Records = 0;
+}
+
+/******************************************************************************
+    Name:   ~RecordBackend
+    Desc:   Default destructor, finishes the trace file
+******************************************************************************/
+RecordBackend::~RecordBackend(void)
+{
+    this->Close();
+}
+
+/******************************************************************************
+    Name:   Open
+    Desc:   Starts a new trace file; calls are passed through either way
+******************************************************************************/
+INT RecordBackend::Open(CHAR *filename)
+{
+    CHAR msg[APP_MAX_CHAR];
+
+    this->Close();
+
+    this->File = fopen(filename, "wb");
+    if (this->File == NULL)
+    {
+        sprintf(msg, "RecordBackend could not create %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    fwrite(TRACE_MAGIC, 1, 4, this->File);
+    this->Records = 0;
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Close
+    Desc:   Writes out what is buffered and closes the trace file
+******************************************************************************/
+void RecordBackend::Close(void)
+{
+    if (this->File == NULL)
+        return;
+
+    this->Flush();
+    fclose(this->File);
+    this->File = NULL;
+}
+
+/******************************************************************************
+    Name:   Flush
+    Desc:   Writes the buffered records out to the trace file
+******************************************************************************/
+void RecordBackend::Flush(void)
+{
+    if ((this->File != NULL) && !this->Buffer.empty())
+    {
+        fwrite(&this->Buffer[0], 1, this->Buffer.size(), this->File);
+        fflush(this->File);
+    }
+
+    this->Buffer.clear();
+}
+
+/******************************************************************************
+    Name:   Append
+    Desc:   Buffers one record and, for register accesses, the (dut, value)
+            pairs of the DUTs in listDut.  Relay calls and failed calls are
+            written out at once, so a crash keeps the trace up to them.
+******************************************************************************/
+void RecordBackend::Append(TraceRecord &rec, BYTE *values, WORD *listDut)
+{
+    if (this->File == NULL)
+        return;
+
+    rec.count = 0;
+    if (listDut != NULL)
+    {
+        while (listDut[rec.count] != 0)
+            rec.count++;
+    }
+
+    BYTE *start = (BYTE*)&rec;
+    this->Buffer.insert(this->Buffer.end(), start, start + sizeof(TraceRecord));
+
+    for (INT d = 0; d < rec.count; d++)
+    {
+        INT dut = listDut[d] - 1;
+        this->Buffer.push_back((BYTE)dut);
+        this->Buffer.push_back(values[dut]);
+    }
+
+    this->Records++;
+
+    if ((rec.op == TRACE_RELAY) || (rec.status != SUCCESS) || (this->Buffer.size() >= TRACE_FLUSH_BYTES))
+        this->Flush();
+}
+
+/******************************************************************************
+    Name:   Relay
+    Desc:   Passes the relay call through and records it
+******************************************************************************/
+INT RecordBackend::Relay(INT chamber, INT action)
+{
+    TraceRecord rec;
+
+    rec.op = TRACE_RELAY;
+    rec.arg1 = (BYTE)chamber;
+    rec.arg2 = (BYTE)action;
+    rec.time = this->Inner->Now();
+    rec.status = this->Inner->Relay(chamber, action);
+    rec.duration = this->Inner->Now() - rec.time;
+
+    this->Append(rec, NULL, NULL);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   ReadReg
+    Desc:   Passes the read through and records the values read back
+******************************************************************************/
+INT RecordBackend::ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    TraceRecord rec;
+
+    rec.op = TRACE_READ;
+    rec.arg1 = page;
+    rec.arg2 = addr;
+    rec.time = this->Inner->Now();
+    rec.status = this->Inner->ReadReg(page, addr, values, listDut);
+    rec.duration = this->Inner->Now() - rec.time;
+
+    this->Append(rec, values, listDut);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   WriteReg
+    Desc:   Passes the write through and records the values written
+******************************************************************************/
+INT RecordBackend::WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    TraceRecord rec;
+
+    rec.op = TRACE_WRITE;
+    rec.arg1 = page;
+    rec.arg2 = addr;
+    rec.time = this->Inner->Now();
+    rec.status = this->Inner->WriteReg(page, addr, values, listDut);
+    rec.duration = this->Inner->Now() - rec.time;
+
+    this->Append(rec, values, listDut);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   Now
+    Desc:   Time of the inner backend
+******************************************************************************/
+DOUBLE RecordBackend::Now(void)
+{
+    return this->Inner->Now();
+}
+
+/******************************************************************************
+    Name:   Wait
+    Desc:   Passes the wait through and records it
+******************************************************************************/
+void RecordBackend::Wait(DOUBLE ms)
+{
+    TraceRecord rec;
+
+    rec.op = TRACE_WAIT;
+    rec.arg1 = 0;
+    rec.arg2 = 0;
+    rec.status = SUCCESS;
+    rec.time = this->Inner->Now();
+    rec.duration = ms;
+
+    this->Inner->Wait(ms);
+    this->Append(rec, NULL, NULL);
+}
+
+/******************************************************************************
+    Name:   ReplayBackend
+    Desc:   Default constructor, nothing to replay until Load
+******************************************************************************/
+ReplayBackend::ReplayBackend(void)
+{
+    this->Scale = 1.0;
+    this->Paced = FALSE;
+
+    this->Rewind();
+}
+
+/******************************************************************************
+    Name:   Load
+    Desc:   Reads a whole trace file into memory and rewinds
+******************************************************************************/
+INT ReplayBackend::Load(CHAR *filename)
+{
+    CHAR msg[APP_MAX_CHAR];
+    CHAR magic[4];
+
+    this->Data.clear();
+    this->Rewind();
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        sprintf(msg, "ReplayBackend could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    if ((fread(magic, 1, 4, file) != 4) || (memcmp(magic, TRACE_MAGIC, 4) != 0))
+    {
+        fclose(file);
+        sprintf(msg, "ReplayBackend: %s is not a hardware trace", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    BYTE chunk[4096];
+    size_t got;
+
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        this->Data.insert(this->Data.end(), chunk, chunk + got);
+
+    fclose(file);
+
+    // a trace cut short by a crash replays up to its last whole record
+    size_t valid = this->Validate();
+    if (valid < this->Data.size())
+    {
+        sprintf(msg, "ReplayBackend: %s ends in a partial or bad record at byte %u, replaying up to it",
+            filename, (DWORD)valid + 4);
+        CUtilities::Error.Add(msg);
+        this->Data.resize(valid);
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Validate
+    Desc:   Returns the size of the whole, well formed records at the start
+            of Data: known op, pairs inside Data and DUTs below TOOL_MAX_DUT
+******************************************************************************/
+size_t ReplayBackend::Validate(void)
+{
+    TraceRecord rec;
+    size_t pos = 0;
+    size_t end;
+
+    while (pos + sizeof(TraceRecord) <= this->Data.size())
+    {
+        memcpy(&rec, &this->Data[pos], sizeof(TraceRecord));
+
+        if ((rec.op < TRACE_RELAY) || (rec.op > TRACE_WAIT) || (rec.count > TOOL_MAX_DUT))
+            return pos;
+
+        end = pos + sizeof(TraceRecord) + 2 * (size_t)rec.count;
+        if (end > this->Data.size())
+            return pos;
+
+        for (INT i = 0; i < rec.count; i++)
+        {
+            if (this->Data[pos + sizeof(TraceRecord) + 2*i] >= TOOL_MAX_DUT)
+                return pos;
+        }
+
+        pos = end;
+    }
+
+    return pos;
+}
+
+/******************************************************************************
+    Name:   Rewind
+    Desc:   Restarts the replay and the virtual clock
+******************************************************************************/
+void ReplayBackend::Rewind(void)
+{
+    this->Pos = 0;
+    this->Clock = 0;
+    this->Replayed = 0;
+    this->Mismatches = 0;
+}
+
+/******************************************************************************
+    Name:   IsDone
+    Desc:   True when every recorded call has been replayed
+******************************************************************************/
+BOOL ReplayBackend::IsDone(void)
+{
+    return (this->Pos + sizeof(TraceRecord) > this->Data.size());
+}
+
+/******************************************************************************
+    Name:   SetTimeScale
+    Desc:   Sets the factor applied to recorded durations and waits
+******************************************************************************/
+void ReplayBackend::SetTimeScale(DOUBLE scale, BOOL paced)
+{
+    this->Scale = scale;
+    this->Paced = paced;
+}
+
+/******************************************************************************
+    Name:   Advance
+    Desc:   Moves the clock forward by the scaled time
+******************************************************************************/
+void ReplayBackend::Advance(DOUBLE ms)
+{
+    ms *= this->Scale;
+    if (ms <= 0)
+        return;
+
+    this->Clock += ms;
+
+    if (this->Paced)
+        std::this_thread::sleep_for(std::chrono::duration<DOUBLE, std::milli>(ms));
+}
+
+/******************************************************************************
+    Name:   Next
+    Desc:   Takes the next recorded call, skipping recorded waits, and checks
+            it is the one being made.  pairs points at its (dut, value)
+            bytes.  A mismatch is logged and does not consume the record.
+            Load keeps only whole records with DUTs below TOOL_MAX_DUT; a
+            record that does not fit in Data is still treated as the end.
+******************************************************************************/
+BOOL ReplayBackend::Next(BYTE op, BYTE arg1, BYTE arg2, TraceRecord &rec, BYTE **pairs)
+{
+    CHAR msg[APP_MAX_CHAR];
+    size_t pos = this->Pos;
+    BOOL whole = FALSE;
+
+    while (pos + sizeof(TraceRecord) <= this->Data.size())
+    {
+        memcpy(&rec, &this->Data[pos], sizeof(TraceRecord));
+
+        whole = (pos + sizeof(TraceRecord) + 2 * (size_t)rec.count <= this->Data.size());
+        if (!whole || (rec.op != TRACE_WAIT))
+            break;
+
+        pos += sizeof(TraceRecord) + 2 * (size_t)rec.count;
+        whole = FALSE;
+    }
+
+    if (!whole)
+    {
+        this->Mismatches++;
+        ERRLog(ERROR_HARDWARE, "ReplayBackend: call made past the end of the trace");
+        return FALSE;
+    }
+
+    if ((rec.op != op) || (rec.arg1 != arg1) || (rec.arg2 != arg2))
+    {
+        this->Mismatches++;
+        sprintf(msg, "ReplayBackend: call %u is op %i (%i, %i), trace has op %i (%i, %i)",
+            this->Replayed, op, arg1, arg2, rec.op, rec.arg1, rec.arg2);
+        ERRLog(ERROR_HARDWARE, msg);
+        return FALSE;
+    }
+
+    *pairs = &this->Data[pos + sizeof(TraceRecord)];
+    this->Pos = pos + sizeof(TraceRecord) + 2 * rec.count;
+    this->Replayed++;
+
+    return TRUE;
+}
+
+/******************************************************************************
+    Name:   Relay
+    Desc:   Replays a relay call
+******************************************************************************/
+INT ReplayBackend::Relay(INT chamber, INT action)
+{
+    TraceRecord rec;
+    BYTE *pairs;
+
+    if (!this->Next(TRACE_RELAY, (BYTE)chamber, (BYTE)action, rec, &pairs))
+        return ERROR_HARDWARE;
+
+    this->Advance(rec.duration);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   ReadReg
+    Desc:   Replays a read: DUTs in listDut that were recorded get the
+            recorded value, others are left alone
+******************************************************************************/
+INT ReplayBackend::ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    TraceRecord rec;
+    BYTE *pairs;
+    BYTE recorded[APP_MAX_DUT];
+    BOOL present[APP_MAX_DUT];
+
+    if (!this->Next(TRACE_READ, page, addr, rec, &pairs))
+        return ERROR_HARDWARE;
+
+    memset(present, 0, sizeof(present));
+    for (INT i = 0; i < rec.count; i++)
+    {
+        recorded[pairs[2*i]] = pairs[2*i + 1];
+        present[pairs[2*i]] = TRUE;
+    }
+
+    INT dut;
+
+    for (INT d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        if (present[dut])
+            values[dut] = recorded[dut];
+    }
+
+    this->Advance(rec.duration);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   WriteReg
+    Desc:   Replays a write; a value that differs from the recorded one is
+            counted as a mismatch, since later reads will not agree with it
+******************************************************************************/
+INT ReplayBackend::WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut)
+{
+    TraceRecord rec;
+    BYTE *pairs;
+    CHAR msg[APP_MAX_CHAR];
+
+    if (!this->Next(TRACE_WRITE, page, addr, rec, &pairs))
+        return ERROR_HARDWARE;
+
+    for (INT i = 0; i < rec.count; i++)
+    {
+        INT dut = pairs[2*i];
+
+        if (values[dut] != pairs[2*i + 1])
+        {
+            this->Mismatches++;
+            sprintf(msg, "ReplayBackend: write %02X:%02X dut %i is 0x%02X, trace has 0x%02X",
+                page, addr, dut, values[dut], pairs[2*i + 1]);
+            ERRLog(ERROR_HARDWARE, msg);
+            break;
+        }
+    }
+
+    this->Advance(rec.duration);
+
+    return rec.status;
+}
+
+/******************************************************************************
+    Name:   Now
+    Desc:   Returns the virtual time in ms
+******************************************************************************/
+DOUBLE ReplayBackend::Now(void)
+{
+    return this->Clock;
+}
+
+/******************************************************************************
+    Name:   Wait
+    Desc:   Advances the clock by the scaled wait
+******************************************************************************/
+void ReplayBackend::Wait(DOUBLE ms)
+{
+    this->Advance(ms);
+}
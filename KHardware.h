@@ -0,0 +1,200 @@
+/*******************************************************************************
+
+    File:   KHardware.h
+    Desc:   Hardware backend definitions for the SPEA x70 Ping-pong tester.
+            Every relay and register access made on behalf of the chambers
+            goes through an HwBackend, so the same test code can run against
+            the real relay matrix or against a local simulation.
+
+            RecordBackend wraps another backend and writes every call to a
+            trace file, and ReplayBackend plays a trace back without a
+            tester, e.g. to profile a lot that misbehaved on the floor:
+
+            RecordBackend rec(SpeaBackend::GetInstance());
+            rec.Open("lot.hwt");
+            Chamber::GetInstance()->SetBackend(&rec);
+
+            ReplayBackend replay;
+            replay.Load("lot.hwt");
+            Chamber::GetInstance()->SetBackend(&replay);
+
+*******************************************************************************/
+#ifndef _K_HARDWARE_H_
+#define _K_HARDWARE_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "KDefines.h"
+
+#ifndef SIM_MAX_PAGES
+#define SIM_MAX_PAGES           4
+#endif
+
+#define SIM_MAX_ADDR            256
+
+#define TRACE_MAGIC             "HWT1"
+#define TRACE_FLUSH_BYTES       65536   // recorder buffer written out at this size
+
+enum trace_op { TRACE_RELAY = 1, TRACE_READ, TRACE_WRITE, TRACE_WAIT };
+
+//-----------------------------------------------------------------------------
+//  one call in a trace file, followed by count (dut, value) byte pairs for
+//  register accesses: the values read back, or the values written
+typedef struct TraceRecord
+{
+    BYTE            op;                 // trace_op
+    BYTE            arg1;               // chamber, or page
+    BYTE            arg2;               // action, or addr
+    BYTE            count;              // DUTs in listDut
+    INT             status;             // what the backend returned
+    DOUBLE          time;               // backend time at the call, ms
+    DOUBLE          duration;           // ms the call took, or the ms waited
+} TraceRecord;
+
+//-----------------------------------------------------------------------------
+//  hardware backend interface
+//  Register accesses work on every DUT in listDut at once, with values laid
+//  out one byte per DUT (values[dut]) like a row of Image::Raw.
+class HwBackend
+{
+public:
+    virtual ~HwBackend(void) {}
+
+    virtual INT Relay(INT chamber, INT action) = 0;
+    virtual INT RelayBatch(INT count, INT *chambers, INT *actions);
+    virtual INT ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut) = 0;
+    virtual INT WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut) = 0;
+
+    // time in ms since the backend was created, and a blocking wait
+    virtual DOUBLE Now(void) = 0;
+    virtual void Wait(DOUBLE ms) = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  SPEA backend (real relay matrix)
+//  Relays only: ReadReg/WriteReg return ERROR_UNIMPLEMENTED, registers are
+//  accessed by the ASIC comms layer in the testplan.
+class SpeaBackend : public HwBackend
+{
+private:
+    DOUBLE Start;
+
+    SpeaBackend(void);
+    static SpeaBackend *Instance;
+
+    DOUBLE Clock(void);
+
+public:
+    static SpeaBackend *GetInstance(void);
+
+    INT Relay(INT chamber, INT action);
+    INT ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    INT WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    DOUBLE Now(void);
+    void Wait(DOUBLE ms);
+};
+
+//-----------------------------------------------------------------------------
+//  simulated backend
+//  Keeps relay and register state in memory and runs on a virtual clock, so
+//  Wait() returns immediately and every operation costs a fixed time.
+class SimBackend : public HwBackend
+{
+private:
+    DOUBLE Clock;
+    INT RelayState[2];
+    BYTE Regs[SIM_MAX_PAGES][SIM_MAX_ADDR][APP_MAX_DUT];
+
+public:
+    DOUBLE RelayTime;                   // ms per relay operation
+    DOUBLE RegTime;                     // ms per register access
+    DWORD RelayOps;
+    DWORD RegOps;
+
+    SimBackend(void);
+
+    INT Relay(INT chamber, INT action);
+    INT ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    INT WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    DOUBLE Now(void);
+    void Wait(DOUBLE ms);
+
+    INT GetRelay(INT chamber);
+    void Reset(void);
+};
+
+//-----------------------------------------------------------------------------
+//  recording backend
+//  Passes every call through to another backend and appends it, with its
+//  result and timing, to a trace file.
+class RecordBackend : public HwBackend
+{
+private:
+    HwBackend *Inner;
+    FILE *File;
+    std::vector<BYTE> Buffer;
+
+    void Append(TraceRecord &rec, BYTE *values, WORD *listDut);
+    void Flush(void);
+
+public:
+    DWORD Records;
+
+    RecordBackend(HwBackend *inner);
+    ~RecordBackend(void);
+
+    INT Open(CHAR *filename);
+    void Close(void);
+
+    INT Relay(INT chamber, INT action);
+    INT ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    INT WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    DOUBLE Now(void);
+    void Wait(DOUBLE ms);
+};
+
+//-----------------------------------------------------------------------------
+//  replay backend
+//  Answers calls from a trace file in order: relay and register calls get
+//  the recorded status, reads get the recorded values, and the clock
+//  advances by the recorded durations times the time scale.  The clock is
+//  virtual unless paced, so a replay gives the same results every run.
+//  A call that does not match the next recorded one is counted and fails
+//  with ERROR_HARDWARE; recorded waits are not matched, since they are
+//  chosen by the test code rather than the hardware.
+class ReplayBackend : public HwBackend
+{
+private:
+    std::vector<BYTE> Data;
+    size_t Pos;
+    DOUBLE Clock;
+    DOUBLE Scale;
+    BOOL Paced;
+
+    size_t Validate(void);
+    BOOL Next(BYTE op, BYTE arg1, BYTE arg2, TraceRecord &rec, BYTE **pairs);
+    void Advance(DOUBLE ms);
+
+public:
+    DWORD Replayed;
+    DWORD Mismatches;
+
+    ReplayBackend(void);
+
+    INT Load(CHAR *filename);
+    void Rewind(void);
+    BOOL IsDone(void);
+
+    // scale 0.5 replays twice as fast; paced also sleeps for the scaled
+    // time, Now() stays on the virtual clock either way
+    void SetTimeScale(DOUBLE scale, BOOL paced = FALSE);
+
+    INT Relay(INT chamber, INT action);
+    INT ReadReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    INT WriteReg(BYTE page, BYTE addr, BYTE *values, WORD *listDut);
+    DOUBLE Now(void);
+    void Wait(DOUBLE ms);
+};
+
+#endif
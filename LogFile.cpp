@@ -0,0 +1,477 @@
+/******************************************************************************
+
+    File:   LogFile.cpp
+    Desc:   LogFile is a subclass in Level 1 that writes the error log to a
+            bounded set of files, rotating by size and age and compressing
+            closed segments on a background thread.
+
+******************************************************************************/
+#include <vector>
+
+#include "Testbench.h"
+#include "LogFile.h"
+
+#define LZS_WINDOW          4096        // offsets 1..4096 (12 bits)
+#define LZS_MIN_MATCH       3
+#define LZS_MAX_MATCH       18          // lengths 3..18 (4 bits)
+#define LZS_HASH_SIZE       4096
+#define LZS_MAX_CHAIN       32
+#define LZS_HEADER          8           // magic + original size
+
+static const char LZS_MAGIC[4] = { 'L', 'Z', 'S', '1' };
+
+FILE* CLogFile::File = NULL;
+String CLogFile::Base;
+long CLogFile::Bytes = 0;
+time_t CLogFile::Opened = 0;
+int CLogFile::Segment = 1;
+long CLogFile::MaxBytes = LOG_DEFAULT_MAX_BYTES;
+long CLogFile::MaxSeconds = LOG_DEFAULT_MAX_SECONDS;
+int CLogFile::Retain = LOG_DEFAULT_RETAIN;
+time_t CLogFile::RetryAt = 0;
+bool CLogFile::RenameFailed = false;
+bool CLogFile::AtExit = false;
+
+std::thread CLogFile::Worker;
+std::mutex CLogFile::Lock;
+std::condition_variable CLogFile::Wake;
+std::deque<int> CLogFile::Pending;
+std::deque<int> CLogFile::Kept;
+bool CLogFile::Stopping = false;
+
+//-----------------------------------------------------------------------------
+//  file helpers
+static bool ReadAll(char* name, std::vector<byte>& data)
+{
+    FILE* file = fopen(name, "rb");
+    if (file == NULL)
+        return false;
+
+    byte buffer[APP_MAX_CHAR];
+    size_t n;
+
+    data.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+    fclose(file);
+    return true;
+}
+
+static bool WriteAll(char* name, std::vector<byte>& data)
+{
+    FILE* file = fopen(name, "wb");
+    if (file == NULL)
+        return false;
+
+    size_t n = data.empty() ? 0 : fwrite(&data[0], 1, data.size(), file);
+
+    fclose(file);
+    return (n == data.size());
+}
+
+static bool Exists(char* name)
+{
+    FILE* file = fopen(name, "rb");
+    if (file == NULL)
+        return false;
+
+    fclose(file);
+    return true;
+}
+
+static int LzsHash(const byte* p)
+{
+    return ((p[0] << 4) ^ (p[1] << 2) ^ p[2]) & (LZS_HASH_SIZE - 1);
+}
+
+/******************************************************************************
+    Name:   CLogFile
+    Desc:   Default constructor
+******************************************************************************/
+CLogFile::CLogFile(void)
+{
+}
+
+/******************************************************************************
+    Name:   ~CLogFile
+    Desc:   Default destructor
+******************************************************************************/
+CLogFile::~CLogFile(void)
+{
+}
+
+/******************************************************************************
+    Name:   Open
+    Desc:   Starts logging to <base>.log.  The segment is rotated once it has
+            max_bytes or is max_seconds old (0 turns either check off), and
+            only the newest retain compressed segments are kept.
+******************************************************************************/
+int CLogFile::Open(char* base, long max_bytes, long max_seconds, int retain)
+{
+    DBGTrace("---> CLogFile::Open");
+
+    String name;
+
+    CLogFile::Close();
+
+    strcpy(CLogFile::Base, base);
+    CLogFile::MaxBytes = max_bytes;
+    CLogFile::MaxSeconds = max_seconds;
+    CLogFile::Retain = retain;
+    CLogFile::Stopping = false;
+    CLogFile::RetryAt = 0;
+    CLogFile::RenameFailed = false;
+    CLogFile::Pending.clear();
+    CLogFile::Kept.clear();
+
+    // pick up segments left by an earlier run: closed ones still need
+    // compressing and compressed ones count against the retention cap.
+    // Numbering continues after the last one found.
+    int last = 0;
+    for (int n = 1; n - last <= LOG_SCAN_GAP; n++)
+    {
+        CLogFile::SegmentName(n, "log", name);
+        if (Exists(name))
+        {
+            CLogFile::Pending.push_back(n);
+            last = n;
+            continue;
+        }
+
+        CLogFile::SegmentName(n, "lzs", name);
+        if (Exists(name))
+        {
+            CLogFile::Kept.push_back(n);
+            last = n;
+        }
+    }
+    CLogFile::Segment = last + 1;
+
+    CLogFile::OpenSegment();
+    if (CLogFile::File == NULL)
+    {
+        cout << "LOG: could not open " << base << ".log" << endl;
+        return ERROR_RUN;
+    }
+
+    // a joinable Worker left at exit would call std::terminate; atexit
+    // handlers run before the destructors of statics built before them
+    if (!CLogFile::AtExit)
+    {
+        atexit(CLogFile::Close);
+        CLogFile::AtExit = true;
+    }
+
+    CLogFile::Worker = std::thread(CLogFile::Compressor);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Close
+    Desc:   Closes the active segment and waits for pending compression
+******************************************************************************/
+void CLogFile::Close(void)
+{
+    if (CLogFile::File != NULL)
+    {
+        fclose(CLogFile::File);
+        CLogFile::File = NULL;
+    }
+
+    if (CLogFile::Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(CLogFile::Lock);
+            CLogFile::Stopping = true;
+        }
+        CLogFile::Wake.notify_one();
+        CLogFile::Worker.join();
+    }
+}
+
+/******************************************************************************
+    Name:   Write
+    Desc:   Appends a line to the active segment, rotating if needed
+******************************************************************************/
+void CLogFile::Write(char* label, char* msg)
+{
+    if (CLogFile::File == NULL)
+        return;
+
+    int n = fprintf(CLogFile::File, "%s%s\n", label, msg);
+    fflush(CLogFile::File);
+
+    if (n > 0)
+        CLogFile::Bytes += n;
+
+    bool full = (CLogFile::MaxBytes > 0) && (CLogFile::Bytes >= CLogFile::MaxBytes);
+    bool old = (CLogFile::MaxSeconds > 0) && ((time(NULL) - CLogFile::Opened) >= CLogFile::MaxSeconds);
+
+    if ((full || old) && (time(NULL) >= CLogFile::RetryAt))
+        CLogFile::Rotate();
+}
+
+/******************************************************************************
+    Name:   OpenSegment
+    Desc:   Opens (or appends to) <base>.log
+******************************************************************************/
+void CLogFile::OpenSegment(void)
+{
+    String name;
+    sprintf(name, "%s.log", (char*)CLogFile::Base);
+
+    CLogFile::File = fopen(name, "a");
+    CLogFile::Opened = time(NULL);
+    CLogFile::Bytes = 0;
+
+    if (CLogFile::File != NULL)
+    {
+        fseek(CLogFile::File, 0, SEEK_END);
+        CLogFile::Bytes = ftell(CLogFile::File);
+    }
+}
+
+/******************************************************************************
+    Name:   Rotate
+    Desc:   Closes the active segment, hands it to the compressor thread and
+            starts a new one.  Only a rename happens on the test thread.  If
+            the rename fails, logging goes on in the same segment and the
+            rotation is retried after LOG_ROTATE_RETRY seconds.
+******************************************************************************/
+void CLogFile::Rotate(void)
+{
+    String active, closed;
+
+    fclose(CLogFile::File);
+    CLogFile::File = NULL;
+
+    sprintf(active, "%s.log", (char*)CLogFile::Base);
+    CLogFile::SegmentName(CLogFile::Segment, "log", closed);
+
+    if (rename(active, closed) == 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(CLogFile::Lock);
+            CLogFile::Pending.push_back(CLogFile::Segment);
+        }
+        CLogFile::Wake.notify_one();
+        CLogFile::Segment++;
+        CLogFile::RenameFailed = false;
+        CLogFile::OpenSegment();
+        return;
+    }
+
+    CLogFile::OpenSegment();
+    CLogFile::RetryAt = time(NULL) + LOG_ROTATE_RETRY;
+
+    // logged once until a rotation succeeds, not through CError (which
+    // writes here)
+    if (!CLogFile::RenameFailed && (CLogFile::File != NULL))
+    {
+        cout << "LOG: could not rename " << (char*)active << " to " << (char*)closed << endl;
+        fprintf(CLogFile::File, "LOG: could not rename %s to %s, rotation retried every %i s\n",
+            (char*)active, (char*)closed, LOG_ROTATE_RETRY);
+        fflush(CLogFile::File);
+        CLogFile::RenameFailed = true;
+    }
+}
+
+/******************************************************************************
+    Name:   Compressor
+    Desc:   Background thread: compresses closed segments and deletes the
+            oldest ones beyond the retention cap.  A segment that failed to
+            compress stays as .log and is deleted by retention all the same.
+******************************************************************************/
+void CLogFile::Compressor(void)
+{
+    String log, lzs;
+    std::unique_lock<std::mutex> lock(CLogFile::Lock);
+
+    while (true)
+    {
+        while (!CLogFile::Stopping && CLogFile::Pending.empty())
+            CLogFile::Wake.wait(lock);
+
+        if (CLogFile::Pending.empty())
+            break;
+
+        int segment = CLogFile::Pending.front();
+        CLogFile::Pending.pop_front();
+        lock.unlock();
+
+        CLogFile::SegmentName(segment, "log", log);
+        CLogFile::SegmentName(segment, "lzs", lzs);
+
+        if (CLogFile::CompressFile(log, lzs) == SUCCESS)
+            remove(log);
+        else
+            remove(lzs);
+
+        lock.lock();
+        CLogFile::Kept.push_back(segment);
+
+        while ((CLogFile::Retain > 0) && ((int)CLogFile::Kept.size() > CLogFile::Retain))
+        {
+            CLogFile::SegmentName(CLogFile::Kept.front(), "lzs", lzs);
+            CLogFile::SegmentName(CLogFile::Kept.front(), "log", log);
+            remove(lzs);
+            remove(log);
+            CLogFile::Kept.pop_front();
+        }
+    }
+}
+
+/******************************************************************************
+    Name:   SegmentName
+    Desc:   Builds <base>.<segment>.<ext>
+******************************************************************************/
+void CLogFile::SegmentName(int segment, const char* ext, char* output)
+{
+    sprintf(output, "%s.%06d.%s", (char*)CLogFile::Base, segment, ext);
+}
+
+/******************************************************************************
+    Name:   CompressFile
+    Desc:   LZSS: a flag byte per 8 tokens (1 = literal byte, 0 = match),
+            matches are 2 bytes of 12 bit offset and 4 bit length
+******************************************************************************/
+int CLogFile::CompressFile(char* input, char* output)
+{
+    std::vector<byte> in, out;
+
+    if (!ReadAll(input, in))
+        return ERROR_RUN;
+
+    int n = (int)in.size();
+    std::vector<int> head(LZS_HASH_SIZE, -1);
+    std::vector<int> prev(LZS_WINDOW, -1);
+
+    out.insert(out.end(), LZS_MAGIC, LZS_MAGIC + 4);
+    for (int b = 0; b < 4; b++)
+        out.push_back((byte)(n >> (8 * b)));
+
+    size_t flags = 0;
+    int bit = 8;
+    int pos = 0;
+
+    while (pos < n)
+    {
+        if (bit == 8)
+        {
+            flags = out.size();
+            out.push_back(0);
+            bit = 0;
+        }
+
+        int best = 0, offset = 0;
+
+        if (pos + LZS_MIN_MATCH <= n)
+        {
+            int limit = (n - pos < LZS_MAX_MATCH) ? n - pos : LZS_MAX_MATCH;
+            int cand = head[LzsHash(&in[pos])];
+
+            for (int chain = 0; (cand >= 0) && (pos - cand <= LZS_WINDOW) && (chain < LZS_MAX_CHAIN); chain++)
+            {
+                int len = 0;
+                while ((len < limit) && (in[cand + len] == in[pos + len]))
+                    len++;
+
+                if (len > best)
+                {
+                    best = len;
+                    offset = pos - cand;
+                    if (len == limit)
+                        break;
+                }
+
+                // the ring may already hold a newer position; stop there
+                int next = prev[cand & (LZS_WINDOW - 1)];
+                if (next >= cand)
+                    break;
+                cand = next;
+            }
+        }
+
+        int step = 1;
+
+        if (best >= LZS_MIN_MATCH)
+        {
+            out.push_back((byte)((offset - 1) >> 4));
+            out.push_back((byte)((((offset - 1) & 0x0F) << 4) | (best - LZS_MIN_MATCH)));
+            step = best;
+        }
+        else
+        {
+            out[flags] |= (byte)(1 << bit);
+            out.push_back(in[pos]);
+        }
+        bit++;
+
+        for (int s = 0; s < step; s++, pos++)
+        {
+            if (pos + LZS_MIN_MATCH > n)
+                continue;
+
+            int h = LzsHash(&in[pos]);
+            prev[pos & (LZS_WINDOW - 1)] = head[h];
+            head[h] = pos;
+        }
+    }
+
+    return WriteAll(output, out) ? SUCCESS : ERROR_RUN;
+}
+
+/******************************************************************************
+    Name:   DecompressFile
+    Desc:   Restores a segment written by CompressFile
+******************************************************************************/
+int CLogFile::DecompressFile(char* input, char* output)
+{
+    std::vector<byte> in, out;
+
+    if (!ReadAll(input, in) || (in.size() < LZS_HEADER) || (memcmp(&in[0], LZS_MAGIC, 4) != 0))
+        return ERROR_RUN;
+
+    size_t size = 0;
+    for (int b = 0; b < 4; b++)
+        size |= (size_t)in[4 + b] << (8 * b);
+
+    size_t pos = LZS_HEADER;
+    out.reserve(size);
+
+    while ((out.size() < size) && (pos < in.size()))
+    {
+        byte flags = in[pos++];
+
+        for (int bit = 0; (bit < 8) && (out.size() < size); bit++)
+        {
+            if (flags & (1 << bit))
+            {
+                if (pos >= in.size())
+                    return ERROR_RUN;
+                out.push_back(in[pos++]);
+                continue;
+            }
+
+            if (pos + 1 >= in.size())
+                return ERROR_RUN;
+
+            size_t offset = (((size_t)in[pos] << 4) | (in[pos + 1] >> 4)) + 1;
+            int len = (in[pos + 1] & 0x0F) + LZS_MIN_MATCH;
+            pos += 2;
+
+            if (offset > out.size())
+                return ERROR_RUN;
+
+            for (int i = 0; i < len; i++)
+                out.push_back(out[out.size() - offset]);
+        }
+    }
+
+    if (out.size() != size)
+        return ERROR_RUN;
+
+    return WriteAll(output, out) ? SUCCESS : ERROR_RUN;
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+
+    File:   LogFile.h
+    Desc:   LogFile is a subclass in Level 1 that writes the error log to a
+            bounded set of files.  The active segment is rotated by size and
+            age, closed segments are compressed on a background thread, and
+            only the newest compressed segments are kept.
+
+            Segments are named <base>.log (active), <base>.<n>.log (closed)
+            and <base>.<n>.lzs (compressed).  The compressor is a small LZSS
+            implementation, and DecompressFile restores a segment.
+
+******************************************************************************/
+#ifndef _LOG_FILE_H_
+#define _LOG_FILE_H_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "Defines.h"
+
+#define LOG_DEFAULT_MAX_BYTES   (16 * 1024 * 1024)
+#define LOG_DEFAULT_MAX_SECONDS (60 * 60)
+#define LOG_DEFAULT_RETAIN      20
+#define LOG_SCAN_GAP            1000    // missing numbers that end the segment scan
+#define LOG_ROTATE_RETRY        60      // seconds before retrying a failed rotation
+
+//-----------------------------------------------------------------------------
+//  LogFile class definition
+class CLogFile
+{
+private:
+    static FILE* File;
+    static String Base;
+    static long Bytes;                  // bytes in the active segment
+    static time_t Opened;               // when the active segment was opened
+    static int Segment;                 // number of the next closed segment
+    static long MaxBytes;
+    static long MaxSeconds;
+    static int Retain;
+    static time_t RetryAt;              // no rotation before this after a failed rename
+    static bool RenameFailed;           // failure already logged
+    static bool AtExit;                 // Close registered with atexit
+
+    static std::thread Worker;
+    static std::mutex Lock;
+    static std::condition_variable Wake;
+    static std::deque<int> Pending;     // closed segments to compress
+    static std::deque<int> Kept;        // closed segments on disk, in order
+    static bool Stopping;
+
+    static void OpenSegment(void);
+    static void Rotate(void);
+    static void Compressor(void);
+    static void SegmentName(int segment, const char* ext, char* output);
+
+public:
+    CLogFile(void);
+    ~CLogFile(void);
+
+    static int Open(char* base, long max_bytes = LOG_DEFAULT_MAX_BYTES,
+        long max_seconds = LOG_DEFAULT_MAX_SECONDS, int retain = LOG_DEFAULT_RETAIN);
+    static void Close(void);
+    static bool IsOpen(void) { return (CLogFile::File != NULL); }
+    static void Write(char* label, char* msg);
+
+    static int CompressFile(char* input, char* output);
+    static int DecompressFile(char* input, char* output);
+};
+
+#endif
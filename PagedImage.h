@@ -0,0 +1,449 @@
+/******************************************************************************
+
+    File:   PagedImage.h
+    Desc:   Register image for _HAS_PAGES_ devices that holds every page of a
+            register map in one block.  Rows are sorted by (page, addr), so
+            the rows of a page are contiguous, and a page directory gives
+            each page's first row and an address to row lookup.  Compare,
+            masked compare against per-page Default specs and decode all
+            work across pages in one call.
+
+            Hardware access goes page by page: Plan builds a ReadPlan over
+            every row (one page select per page, current page first) and
+            Scatter puts the bytes read back into the rows, and Order gives
+            the same page order for writes.
+
+            Rows of a map built from a RegField table are the same rows
+            RegMapBytes gives.
+
+******************************************************************************/
+#ifndef _PAGED_IMAGE_H_
+#define _PAGED_IMAGE_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+#include "RegisterMap.h"
+#include "ReadPlan.h"
+
+#define PAGED_MAX_PAGES         16
+#define PAGED_NO_ROW            -1
+
+//-----------------------------------------------------------------------------
+//  PageEntry struct
+//  One page in the directory of a PagedImage
+typedef struct PageEntry
+{
+    byte            page;
+    int             first;              // first row of the page
+    int             rows;               // rows on the page
+    short           row[256];           // row of each address, or PAGED_NO_ROW
+} PageEntry;
+
+//-----------------------------------------------------------------------------
+//  PagedImage struct
+//  Raw holds rows * TOOL_MAX_DUT bytes laid out [row][dut] like Image::Raw.
+//  Spec and Mask hold one byte per row for CompareDefault.
+typedef struct PagedImage
+{
+    vector<PageEntry>   Pages;          // in page order
+    vector<word>        Keys;           // (page << 8) | addr of every row
+    vector<byte>        Raw;
+    vector<byte>        Spec;
+    vector<byte>        Mask;
+    memory_type         memory;
+    int                 rows;
+
+    PagedImage(void) : memory(Volatile), rows(0) {}
+
+    PagedImage(const RegField* t, int n) : memory((n > 0) ? t[0].memory : Volatile), rows(0)
+    {
+        Build(t, n);
+    }
+
+    // lay out the rows of every byte in a register map
+    void Build(const RegField* t, int n)
+    {
+        vector<word> keys;
+
+        for (int i = 0; i < n; i++)
+        {
+            for (int a = 0; a < t[i].num; a++)
+                keys.push_back((word)RegKey(t[i], a));
+        }
+
+        Layout(keys);
+    }
+
+    void Build(vector<ASICregister>& regs)
+    {
+        vector<word> keys;
+        vector<ASICregister>::iterator it;
+
+        for (it = regs.begin(); it != regs.end(); ++it)
+        {
+            for (int a = 0; (a < APP_MAX_ADDR) && (it->addr[a] != ADDR_INVALID); a++)
+                keys.push_back((word)((it->page << 8) | it->addr[a]));
+        }
+
+        Layout(keys);
+    }
+
+    // directory entry of a page, or NULL
+    PageEntry* Find(byte page)
+    {
+        for (size_t p = 0; p < Pages.size(); p++)
+        {
+            if (Pages[p].page == page)
+                return &Pages[p];
+        }
+        return NULL;
+    }
+
+    int Row(byte page, byte addr)
+    {
+        PageEntry* entry = Find(page);
+        return (entry == NULL) ? PAGED_NO_ROW : entry->row[addr];
+    }
+
+    // rows of one page, [rows][TOOL_MAX_DUT] like Image::Raw
+    byte* PageRaw(byte page)
+    {
+        PageEntry* entry = Find(page);
+        return (entry == NULL) ? NULL : &Raw[entry->first * TOOL_MAX_DUT];
+    }
+
+    byte Get(byte page, byte addr, int dut)
+    {
+        int row = Row(page, addr);
+        return (row == PAGED_NO_ROW) ? 0 : Raw[row * TOOL_MAX_DUT + dut];
+    }
+
+    // write path: set one register for the DUTs in listDut
+    void Write(byte page, byte addr, byte* values, word* listDut)
+    {
+        int dut;
+        int row = Row(page, addr);
+
+        if (row == PAGED_NO_ROW)
+        {
+            ERRLog(ERROR_UNDEFINED, "PagedImage has no row for that page and address.");
+            return;
+        }
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            Raw[row * TOOL_MAX_DUT + dut] = values[dut];
+        }
+    }
+
+    // copy one page to or from a single page image.  Image::Raw is indexed
+    // by address, so only the addresses in the map are copied.
+    void SetPage(Image& img)
+    {
+        PageEntry* entry = Find(img.page);
+        if (entry == NULL)
+            return;
+
+        for (int a = 0; a < NUM_RAM_REG; a++)
+        {
+            if (entry->row[a] != PAGED_NO_ROW)
+                memcpy(&Raw[entry->row[a] * TOOL_MAX_DUT], img.Raw[a], TOOL_MAX_DUT);
+        }
+    }
+
+    void GetPage(Image& img)
+    {
+        PageEntry* entry = Find(img.page);
+        if (entry == NULL)
+            return;
+
+        for (int a = 0; a < NUM_RAM_REG; a++)
+        {
+            if (entry->row[a] != PAGED_NO_ROW)
+                memcpy(img.Raw[a], &Raw[entry->row[a] * TOOL_MAX_DUT], TOOL_MAX_DUT);
+        }
+        img.MarkAllDirty();
+    }
+
+    // spec and mask of one page, by address like SetPage
+    void SetDefault(byte page, Default& spec)
+    {
+        PageEntry* entry = Find(page);
+        if (entry == NULL)
+            return;
+
+        for (int a = 0; a < NUM_RAM_REG; a++)
+        {
+            if (entry->row[a] != PAGED_NO_ROW)
+            {
+                Spec[entry->row[a]] = spec.SpecImage[a];
+                Mask[entry->row[a]] = spec.Mask[a];
+            }
+        }
+    }
+
+    // compare every page with an image of the same layout; difference is
+    // rows * TOOL_MAX_DUT bytes
+    void Compare(PagedImage& img, byte* difference, bool* result, word* listDut)
+    {
+        if (img.Keys != Keys)
+        {
+            ERRLog(ERROR_SPEC, "PagedImage compare of images with different layouts.");
+            return;
+        }
+
+        CompareRows(img.Raw.empty() ? NULL : &img.Raw[0], TOOL_MAX_DUT, 1, NULL, img.memory.name,
+            difference, result, listDut);
+    }
+
+    // masked compare of every page against the specs from SetDefault
+    void CompareDefault(byte* difference, bool* result, word* listDut)
+    {
+        CompareRows(Spec.empty() ? NULL : &Spec[0], 1, 0, Mask.empty() ? NULL : &Mask[0], "Masked Default",
+            difference, result, listDut);
+    }
+
+    // decode every field of a map (the one given to Build) into
+    // converted[n][TOOL_MAX_DUT]
+    void Decode(const RegField* t, int n, int* converted, word* listDut)
+    {
+        int dut;
+        int row[APP_MAX_ADDR];
+        int shift[APP_MAX_ADDR];
+
+        for (int f = 0; f < n; f++)
+        {
+            int width = RegFieldBits(t[f]);
+            int* out = &converted[f * TOOL_MAX_DUT];
+
+            for (int a = 0; a < t[f].num; a++)
+            {
+                row[a] = Row(t[f].page, t[f].addr[a]);
+                shift[a] = RegFieldBits(t[f], a);
+            }
+
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                dword value = 0;
+
+                for (int a = 0; a < t[f].num; a++)
+                {
+                    if (row[a] != PAGED_NO_ROW)
+                        value |= Extract(Raw[row[a] * TOOL_MAX_DUT + dut], t[f].mask[a]) << shift[a];
+                }
+
+                // sign extend
+                if ( (t[f].conversion == twos_comp) && (width < 32) && ((value >> (width - 1)) & 1) )
+                    value |= ~0u << width;
+
+                out[dut] = (int)value;
+            }
+        }
+    }
+
+    // page visit order for writes: directory indices, currPage first.
+    // Returns the page-select writes needed.
+    int Order(int* order, int currPage = READPLAN_NO_PAGE)
+    {
+        int count = 0;
+        int switches = 0;
+
+        for (size_t p = 0; p < Pages.size(); p++)
+        {
+            if (Pages[p].page == currPage)
+                order[count++] = (int)p;
+        }
+        for (size_t p = 0; p < Pages.size(); p++)
+        {
+            if (Pages[p].page != currPage)
+            {
+                order[count++] = (int)p;
+                switches++;
+            }
+        }
+
+        return switches;
+    }
+
+    // plan reads of every row, currPage first
+    void Plan(ReadPlan& plan, int currPage = READPLAN_NO_PAGE)
+    {
+        plan.Build(Keys.empty() ? NULL : &Keys[0], rows, currPage);
+    }
+
+    // put a plan's read buffer ([plan.total][TOOL_MAX_DUT]) into the rows
+    void Scatter(ReadPlan& plan, const byte* buffer, word* listDut)
+    {
+        int dut, row;
+        vector<ReadBurst>::iterator it;
+
+        for (it = plan.bursts.begin(); it != plan.bursts.end(); ++it)
+        {
+            for (int i = 0; i < it->length; i++)
+            {
+                row = Row(it->page, (byte)(it->start + i));
+                if (row == PAGED_NO_ROW)
+                    continue;
+
+                const byte* src = &buffer[(it->offset + i) * TOOL_MAX_DUT];
+                byte* dst = &Raw[row * TOOL_MAX_DUT];
+
+                for (int d = 0; listDut[d] != 0; d++)
+                {
+                    dut = listDut[d] - 1;
+                    dst[dut] = src[dut];
+                }
+            }
+        }
+    }
+
+    // print raw image for 1 DUT, one line per page
+    void Print(int dut)
+    {
+        String msg;
+
+        // always display
+        bool was_on = DBGVerboseEnabled;
+        DBGVerboseEnabled = YES;
+
+        for (size_t p = 0; p < Pages.size(); p++)
+        {
+            String output = B2S(&Raw[Pages[p].first * TOOL_MAX_DUT + dut], Pages[p].rows);
+            sprintf(msg, "\n%sPaged Image Page%02X[%i]: %s", (char*)memory.name, Pages[p].page, dut, (char*)output);
+            DBGVerbose(msg);
+        }
+
+        DBGVerboseEnabled = was_on;
+    }
+
+private:
+    // sort and dedupe keys, then build rows and the page directory.  Pages
+    // past PAGED_MAX_PAGES and their rows are dropped.
+    void Layout(vector<word>& keys)
+    {
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        Keys = keys;
+        rows = (int)keys.size();
+        Pages.clear();
+
+        for (int i = 0; i < rows; i++)
+        {
+            byte page = (byte)(keys[i] >> 8);
+
+            if (Pages.empty() || (Pages.back().page != page))
+            {
+                if (Pages.size() >= PAGED_MAX_PAGES)
+                {
+                    ERRLog(ERROR_INIT, "PagedImage map has more pages than PAGED_MAX_PAGES.");
+                    Keys.resize(i);
+                    rows = i;
+                    break;
+                }
+
+                PageEntry entry;
+                entry.page = page;
+                entry.first = i;
+                entry.rows = 0;
+                for (int a = 0; a < 256; a++)
+                    entry.row[a] = PAGED_NO_ROW;
+                Pages.push_back(entry);
+            }
+
+            Pages.back().row[keys[i] & 0xFF] = (short)i;
+            Pages.back().rows++;
+        }
+
+        Raw.assign(rows * TOOL_MAX_DUT, 0x00);
+        Spec.assign(rows, 0x00);
+        Mask.assign(rows, 0x00);
+    }
+
+    // the masked bits of b, packed down to the low bits
+    static dword Extract(byte b, byte mask)
+    {
+        dword out = 0;
+        int pos = 0;
+
+        for (; mask != 0; mask &= (byte)(mask - 1))
+        {
+            if (b & mask & (byte)(-mask))
+                out |= (1u << pos);
+            pos++;
+        }
+        return out;
+    }
+
+    // compare Raw with other under mask (one byte per row, NULL for all
+    // bits); byte (row, dut) of other is at row * rowStride + dut * dutStride
+    void CompareRows(const byte* other, int rowStride, int dutStride, const byte* mask, const char* name,
+        byte* difference, bool* result, word* listDut)
+    {
+        bool failed;
+        int dut;
+        byte m, x;
+
+        for (int i = 0; i < TOOL_MAX_DUT; i++)
+            result[i] = true;
+
+        if (rows == 0)
+            return;
+
+        if (difference != NULL)
+            memset(difference, 0x00, rows * TOOL_MAX_DUT);
+
+        for (int i = 0; i < rows; i++)
+        {
+            m = (mask == NULL) ? 0xFF : mask[i];
+
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                x = (byte)((Raw[i * TOOL_MAX_DUT + dut] ^ other[i * rowStride + dut * dutStride]) & m);
+
+                if (x != 0)
+                    result[dut] = false;
+                if (difference != NULL)
+                    difference[i * TOOL_MAX_DUT + dut] = x;
+            }
+        }
+
+        if (!DBGVerboseEnabled || (difference == NULL))
+            return;
+
+        ScratchScope scratch;
+        String* temp = scratch.New<String>(TOOL_MAX_DUT);
+        char msg[APP_MAX_CHAR_LONGER];
+
+        for (size_t p = 0; p < Pages.size(); p++)
+        {
+            B2SArray(&temp[0], &difference[Pages[p].first * TOOL_MAX_DUT], Pages[p].rows, listDut);
+
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+
+                // only the pages this DUT fails on
+                failed = false;
+                for (int i = 0; i < Pages[p].rows; i++)
+                    failed |= (difference[(Pages[p].first + i) * TOOL_MAX_DUT + dut] != 0);
+
+                if (failed)
+                {
+                    sprintf_s(msg, APP_MAX_CHAR_LONGER, "\n%sPaged Image diff %s Page%02X [%i]: ",
+                        (char*)memory.name, name, Pages[p].page, dut);
+                    strcat_s(msg, APP_MAX_CHAR_LONGER, temp[dut]);
+                    DBGVerbose(msg);
+                }
+            }
+        }
+    }
+} PagedImage;
+
+#endif
@@ -0,0 +1,169 @@
+/******************************************************************************
+
+    File:   PatEngine.cpp
+    Desc:   PatEngine flags outliers across the DUTs of a list against robust
+            limits from order statistics.
+
+******************************************************************************/
+#include <math.h>
+#include <algorithm>
+
+#include "PatEngine.h"
+
+/******************************************************************************
+    Name:   PatEngine
+    Desc:   Constructor, k is the number of (scaled) MADs or IQRs allowed
+******************************************************************************/
+PatEngine::PatEngine(pat_method method, double k)
+{
+    this->Method = method;
+    this->K = k;
+    this->MinSpread = 0.0;
+    this->MinCount = PAT_DEFAULT_MIN_COUNT;
+}
+
+/******************************************************************************
+    Name:   ~PatEngine
+    Desc:   Default destructor
+******************************************************************************/
+PatEngine::~PatEngine(void)
+{
+}
+
+/******************************************************************************
+    Name:   Quantile
+    Desc:   Interpolated quantile by selection; reorders values
+******************************************************************************/
+double PatEngine::Quantile(double* values, int count, double q)
+{
+    double pos = q * (count - 1);
+    int lo = (int)floor(pos);
+    double frac = pos - lo;
+
+    std::nth_element(values, values + lo, values + count);
+    double value = values[lo];
+
+    // the next order statistic is the smallest value above lo
+    if ((frac > 0.0) && (lo + 1 < count))
+        value += frac * (*std::min_element(values + lo + 1, values + count) - value);
+
+    return value;
+}
+
+/******************************************************************************
+    Name:   Run
+    Desc:   Computes limits from the DUTs in listDut (values[dut], 0 based)
+            and flags the ones outside them.  flags is set for every DUT,
+            false for DUTs not in the list.  Returns the number flagged.
+******************************************************************************/
+int PatEngine::Run(const double* values, word* listDut, bool* flags, PatLimits* limits)
+{
+    DBGTrace("---> PatEngine::Run");
+
+    double sample[TOOL_MAX_DUT];
+    double work[TOOL_MAX_DUT];
+    int count = 0;
+
+    for (int i = 0; i < TOOL_MAX_DUT; i++)
+        flags[i] = false;
+
+    for (int d = 0; listDut[d] != 0; d++)
+        sample[count++] = values[listDut[d] - 1];
+
+    memset(limits, 0, sizeof(PatLimits));
+    limits->count = count;
+    limits->low = -HUGE_VAL;
+    limits->high = HUGE_VAL;
+
+    if ((count == 0) || (count < this->MinCount))
+        return 0;
+
+    memcpy(work, sample, count * sizeof(double));
+    limits->median = PatEngine::Quantile(work, count, 0.5);
+
+    if (this->Method == PAT_MAD)
+    {
+        for (int i = 0; i < count; i++)
+            work[i] = fabs(sample[i] - limits->median);
+
+        limits->spread = PAT_MAD_SCALE * PatEngine::Quantile(work, count, 0.5);
+        if (limits->spread < this->MinSpread)
+            limits->spread = this->MinSpread;
+
+        limits->low = limits->median - (this->K * limits->spread);
+        limits->high = limits->median + (this->K * limits->spread);
+    }
+    else
+    {
+        memcpy(work, sample, count * sizeof(double));
+        limits->q1 = PatEngine::Quantile(work, count, 0.25);
+        limits->q3 = PatEngine::Quantile(work, count, 0.75);
+
+        limits->spread = limits->q3 - limits->q1;
+        if (limits->spread < this->MinSpread)
+            limits->spread = this->MinSpread;
+
+        limits->low = limits->q1 - (this->K * limits->spread);
+        limits->high = limits->q3 + (this->K * limits->spread);
+    }
+
+    // sample is in listDut order
+    for (int d = 0; d < count; d++)
+    {
+        bool outside = (sample[d] < limits->low) | (sample[d] > limits->high);
+        flags[listDut[d] - 1] = outside;
+        limits->flagged += outside;
+    }
+
+    return limits->flagged;
+}
+
+int PatEngine::Run(const int* values, word* listDut, bool* flags, PatLimits* limits)
+{
+    double converted[TOOL_MAX_DUT];
+
+    for (int d = 0; listDut[d] != 0; d++)
+        converted[listDut[d] - 1] = (double)values[listDut[d] - 1];
+
+    return this->Run(converted, listDut, flags, limits);
+}
+
+/******************************************************************************
+    Name:   Run
+    Desc:   Same, on one decoded field of an image
+******************************************************************************/
+int PatEngine::Run(Image& img, int field, word* listDut, bool* flags, PatLimits* limits)
+{
+    return this->Run(img.Converted[field], listDut, flags, limits);
+}
+
+/******************************************************************************
+    Name:   Print
+    Desc:   Prints the limits and the flagged DUTs
+******************************************************************************/
+void PatEngine::Print(PatLimits& limits, bool* flags, word* listDut)
+{
+    int dut;
+    char msg[APP_MAX_CHAR_LONGER];
+    String temp;
+
+    sprintf(msg, "\nPAT %s: n %i median %.3f spread %.3f limits [%.3f, %.3f] flagged %i:",
+        (this->Method == PAT_MAD) ? "MAD" : "IQR", limits.count, limits.median, limits.spread,
+        limits.low, limits.high, limits.flagged);
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+        if (!flags[dut])
+            continue;
+
+        sprintf(temp, " %i", dut);
+        strcat_s(msg, APP_MAX_CHAR_LONGER, temp);
+    }
+
+    // always display
+    bool was_on = DBGVerboseEnabled;
+    DBGVerboseEnabled = YES;
+    DBGVerbose(msg);
+    DBGVerboseEnabled = was_on;
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+
+    File:   PatEngine.h
+    Desc:   PatEngine flags outliers for part-average testing.  Robust limits
+            (median +/- k * MAD, or quartiles +/- k * IQR) are computed from
+            the values of the DUTs in a list with nth_element selection, and
+            every DUT outside them is flagged.  Values come straight from
+            Image::Converted or from a per-DUT test array, with no copy
+            through CopyArrayToDouble.
+
+            Example, per chamber on the K tester:
+
+            PatEngine pat(PAT_MAD, 6.0);
+            PatLimits limits;
+            bool outlier[TOOL_MAX_DUT];
+            pat.Run(img, field, Chamber::GetInstance()->GetDutList(), outlier, &limits);
+
+******************************************************************************/
+#ifndef _PAT_ENGINE_H_
+#define _PAT_ENGINE_H_
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+#define PAT_DEFAULT_MIN_COUNT   8       // fewer DUTs than this are not judged
+#define PAT_MAD_SCALE           1.4826  // MAD to sigma for normal data
+
+enum pat_method { PAT_MAD, PAT_IQR };
+
+//-----------------------------------------------------------------------------
+//  limits used by the last Run
+typedef struct PatLimits
+{
+    double          median;
+    double          q1;
+    double          q3;
+    double          spread;             // scaled MAD or IQR
+    double          low;
+    double          high;
+    int             count;              // DUTs the limits were computed from
+    int             flagged;
+} PatLimits;
+
+//-----------------------------------------------------------------------------
+//  PatEngine class definition
+class PatEngine
+{
+private:
+    pat_method Method;
+    double K;
+    double MinSpread;                   // floor on spread, for near-constant data
+    int MinCount;
+
+    static double Quantile(double* values, int count, double q);
+
+public:
+    PatEngine(pat_method method = PAT_MAD, double k = 6.0);
+    ~PatEngine(void);
+
+    void SetMethod(pat_method method, double k) { this->Method = method; this->K = k; }
+    void SetMinSpread(double spread) { this->MinSpread = spread; }
+    void SetMinCount(int count) { this->MinCount = count; }
+
+    int Run(const double* values, word* listDut, bool* flags, PatLimits* limits);
+    int Run(const int* values, word* listDut, bool* flags, PatLimits* limits);
+    int Run(Image& img, int field, word* listDut, bool* flags, PatLimits* limits);
+
+    void Print(PatLimits& limits, bool* flags, word* listDut);
+};
+
+#endif
@@ -0,0 +1,218 @@
+/******************************************************************************
+
+    File:   ReadPlan.h
+    Desc:   Builds an access plan for a set of ASIC registers: registers are
+            grouped by page, every byte is fetched once no matter how many
+            registers share it, and nearby addresses are merged into burst
+            reads.
+
+******************************************************************************/
+#ifndef _READ_PLAN_H_
+#define _READ_PLAN_H_
+
+#include <vector>
+#include <algorithm>
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+// number of unrequested bytes a burst may read through to avoid a new burst
+#define READPLAN_DEFAULT_GAP    2
+#define READPLAN_MAX_BURST      MAX_PAGE_SIZE
+#define READPLAN_NO_PAGE        -1
+
+//-----------------------------------------------------------------------------
+//  ReadBurst struct
+//  One bus transaction: length consecutive bytes starting at start on page
+typedef struct ReadBurst
+{
+    byte            page;
+    byte            start;
+    int             length;
+    int             offset;             // where the burst lands in the read buffer
+
+    ReadBurst(void) : page(0), start(0), length(0), offset(0) {}
+
+    ReadBurst(byte page_in, byte start_in, int offset_in)
+        : page(page_in), start(start_in), length(1), offset(offset_in) {}
+} ReadBurst;
+
+//-----------------------------------------------------------------------------
+//  ReadPlan struct
+//  Used for planning register reads with the fewest page switches and bus
+//  transactions.  The bursts are read back to back into one buffer, and
+//  Offset() tells where any planned byte ended up.
+typedef struct ReadPlan
+{
+    vector<ReadBurst>   bursts;
+    int                 gap;            // max unrequested bytes merged into a burst
+    int                 maxBurst;       // max bytes in one burst
+    int                 requested;      // distinct bytes asked for
+    int                 total;          // bytes actually read (includes gaps)
+    int                 pageSwitches;   // page-select writes needed
+
+    ReadPlan(void) : gap(READPLAN_DEFAULT_GAP), maxBurst(READPLAN_MAX_BURST)
+    {
+        Clear();
+    }
+
+    ReadPlan(int gap_in, int max_in = READPLAN_MAX_BURST) : gap(gap_in), maxBurst(max_in)
+    {
+        Clear();
+    }
+
+    void Clear(void)
+    {
+        bursts.clear();
+        requested = 0;
+        total = 0;
+        pageSwitches = 0;
+    }
+
+    // plan reads of every byte in regs.  currPage is the page the ASIC is
+    // already on (or READPLAN_NO_PAGE), and is visited first.
+    void Build(vector<ASICregister>& regs, int currPage = READPLAN_NO_PAGE)
+    {
+        vector<int> keys;
+        vector<ASICregister>::iterator it;
+
+        Clear();
+
+        // collect (page, addr) for every byte of every register
+        for (it = regs.begin(); it != regs.end(); ++it)
+        {
+            for (int a = 0; (a < APP_MAX_ADDR) && (it->addr[a] != ADDR_INVALID); a++)
+                keys.push_back(Key(it->page, it->addr[a], currPage));
+        }
+
+        PlanKeys(keys, currPage);
+    }
+
+    void Build(RAMstruct& RAMregisters, int currPage = READPLAN_NO_PAGE)
+    {
+        Build(RAMregisters.RAMvector, currPage);
+    }
+
+    // plan reads of count bytes given as (page << 8) | addr
+    void Build(const word* bytes, int count, int currPage = READPLAN_NO_PAGE)
+    {
+        vector<int> keys;
+
+        Clear();
+
+        for (int i = 0; i < count; i++)
+            keys.push_back(Key((byte)(bytes[i] >> 8), (byte)bytes[i], currPage));
+
+        PlanKeys(keys, currPage);
+    }
+
+    // index of (page, addr) in the read buffer, or -1 if it is not planned
+    int Offset(byte page, byte addr)
+    {
+        vector<ReadBurst>::iterator it;
+        for (it = bursts.begin(); it != bursts.end(); ++it)
+        {
+            if ( (it->page == page) && (addr >= it->start) && (addr < it->start + it->length) )
+                return it->offset + (addr - it->start);
+        }
+        return -1;
+    }
+
+    // prints the bursts and totals for debug, over several messages when
+    // there are too many bursts for one
+    void Print(void)
+    {
+        char msg[APP_MAX_CHAR_LONGER];
+        String temp;
+        vector<ReadBurst>::iterator it;
+
+        // always display
+        bool was_on = DBGVerboseEnabled;
+        DBGVerboseEnabled = YES;
+
+        sprintf(msg, "\nReadPlan: %i bursts, %i bytes read for %i requested, %i page switches\n",
+            (int)bursts.size(), total, requested, pageSwitches);
+
+        for (it = bursts.begin(); it != bursts.end(); ++it)
+        {
+            #ifdef _HAS_PAGES_
+                sprintf(temp, "Page%02X Addr %02X-%02X (%i)\n", it->page, it->start, it->start + it->length - 1, it->length);
+            #else
+                sprintf(temp, "Addr %02X-%02X (%i)\n", it->start, it->start + it->length - 1, it->length);
+            #endif
+            PrintLine(msg, temp);
+        }
+
+        DBGVerbose(msg);
+        DBGVerboseEnabled = was_on;
+    }
+
+    // appends a line to msg, printing msg first if it would not fit
+    static void PrintLine(char* msg, const char* line)
+    {
+        if (strlen(msg) + strlen(line) >= APP_MAX_CHAR_LONGER)
+        {
+            DBGVerbose(msg);
+            msg[0] = '\0';
+        }
+
+        strncat(msg, line, APP_MAX_CHAR_LONGER - 1 - strlen(msg));
+    }
+
+private:
+    // sort by page then address, and fetch shared bytes once
+    void PlanKeys(vector<int>& keys, int currPage)
+    {
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+
+        requested = (int)keys.size();
+
+        int page, addr;
+        int lastPage = currPage;
+
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            page = Page(keys[k], currPage);
+            addr = keys[k] & 0xFF;
+
+            if (page != lastPage)
+            {
+                pageSwitches++;
+                lastPage = page;
+            }
+
+            if (!bursts.empty())
+            {
+                ReadBurst& last = bursts.back();
+                int end = last.start + last.length;     // one past last byte read
+
+                if ( (last.page == page) && (addr - end <= gap) &&
+                     (addr - last.start + 1 <= maxBurst) )
+                {
+                    total += addr - end + 1;
+                    last.length = addr - last.start + 1;
+                    continue;
+                }
+            }
+
+            bursts.push_back(ReadBurst((byte)page, (byte)addr, total));
+            total++;
+        }
+    }
+
+    // sort key that puts currPage ahead of every other page
+    static int Key(byte page, byte addr, int currPage)
+    {
+        int order = (page == currPage) ? 0 : page + 1;
+        return (order << 8) | addr;
+    }
+
+    static int Page(int key, int currPage)
+    {
+        int order = key >> 8;
+        return (order == 0) ? currPage : order - 1;
+    }
+} ReadPlan;
+
+#endif
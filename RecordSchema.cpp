@@ -0,0 +1,276 @@
+/******************************************************************************
+
+    File:   RecordSchema.cpp
+    Desc:   Fixed-schema binary test records, built once from the datalog
+            label formats and filled with plain copies during the run.
+
+******************************************************************************/
+#include "RecordSchema.h"
+
+#define RECORD_MAGIC            "REC1"
+
+/******************************************************************************
+    Name:   RecordSchema
+    Desc:   Default constructor
+******************************************************************************/
+RecordSchema::RecordSchema(void)
+{
+    this->Size = 0;
+    this->Frozen = false;
+}
+
+/******************************************************************************
+    Name:   ~RecordSchema
+    Desc:   Default destructor
+******************************************************************************/
+RecordSchema::~RecordSchema(void)
+{
+}
+
+/******************************************************************************
+    Name:   TypeSize
+    Desc:   Bytes a value of a type takes in a record
+******************************************************************************/
+int RecordSchema::TypeSize(variable_type type)
+{
+    switch (type)
+    {
+        case bool_type:     return sizeof(bool);
+        case byte_type:     return sizeof(byte);
+        case int_type:      return sizeof(int);
+        case uint_type:     return sizeof(uint);
+        case double_type:   return sizeof(double);
+        case word_type:     return sizeof(word);
+        case dword_type:    return sizeof(dword);
+        case qword_type:    return sizeof(qword);
+        case scope_type:    return sizeof(byte);
+        default:            return 0;
+    }
+}
+
+/******************************************************************************
+    Name:   AddColumn
+    Desc:   Adds a column at the end of the record, returns its index.  Not
+            allowed once a RecordLog uses the schema, records already stored
+            would no longer match it.
+******************************************************************************/
+int RecordSchema::AddColumn(char* label, variable_type type, char* format)
+{
+    DBGTrace("---> RecordSchema::AddColumn");
+
+    RecordColumn col;
+
+    if (this->Frozen)
+    {
+        String msg;
+        sprintf(msg, "RecordSchema: %s added after a RecordLog was created", label);
+        ERRLog(ERROR_INIT, msg);
+        return -1;
+    }
+
+    if (RecordSchema::TypeSize(type) == 0)
+    {
+        String msg;
+        sprintf(msg, "RecordSchema: unknown type %i for %s", type, label);
+        ERRLog(ERROR_UNDEFINED, msg);
+        return -1;
+    }
+
+    strcpy(col.label, label);
+    strcpy(col.format, format);
+    col.type = type;
+    col.offset = this->Size;
+    col.size = RecordSchema::TypeSize(type);
+
+    this->Size += col.size;
+    this->Columns.push_back(col);
+
+    return (int)this->Columns.size() - 1;
+}
+
+/******************************************************************************
+    Name:   AddColumns
+    Desc:   Adds one column per label and index in the same order as
+            CUtilities::FormatString (indices outer, labels inner), so the
+            columns line up with the datalog header.  Returns the index of
+            the first column.
+******************************************************************************/
+int RecordSchema::AddColumns(String* labels_in, String labelFormat, int count, variable_type type,
+    char* format, String* indicies)
+{
+    DBGTrace("---> RecordSchema::AddColumns");
+
+    String label;
+    int first = (int)this->Columns.size();
+
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; labels_in[j][0] != '\0'; j++)
+        {
+            if (indicies != NULL)
+                sprintf_s(label, APP_MAX_CHAR, (char *) labelFormat, (char *) labels_in[j], (char *) indicies[i]);
+            else
+                sprintf_s(label, APP_MAX_CHAR, (char *) labelFormat, (char *) labels_in[j]);
+
+            if (this->AddColumn(label, type, format) < 0)
+                return -1;
+        }
+    }
+
+    return first;
+}
+
+/******************************************************************************
+    Name:   Find
+    Desc:   Index of the column with a label, or -1
+******************************************************************************/
+int RecordSchema::Find(char* label)
+{
+    for (size_t i = 0; i < this->Columns.size(); i++)
+    {
+        if (strcmp(this->Columns[i].label, label) == 0)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+    Name:   RecordLog
+    Desc:   Constructor, freezes the schema (it must be complete)
+******************************************************************************/
+RecordLog::RecordLog(RecordSchema& schema) : Schema(schema)
+{
+    this->Schema.Freeze();
+    this->Clear();
+}
+
+/******************************************************************************
+    Name:   ~RecordLog
+    Desc:   Default destructor
+******************************************************************************/
+RecordLog::~RecordLog(void)
+{
+}
+
+/******************************************************************************
+    Name:   Clear
+    Desc:   Drops all records at the start of a lot
+******************************************************************************/
+void RecordLog::Clear(void)
+{
+    this->Current.assign(TOOL_MAX_DUT * this->Schema.GetSize(), 0);
+    this->Data.clear();
+    this->Records = 0;
+}
+
+/******************************************************************************
+    Name:   Commit
+    Desc:   Appends the current record of every DUT in listDut and clears
+            them for the next insertion
+******************************************************************************/
+void RecordLog::Commit(word* listDut)
+{
+    int size = this->Schema.GetSize();
+    int dut;
+
+    for (int d = 0; listDut[d] != 0; d++)
+    {
+        dut = listDut[d] - 1;
+
+        const byte* id = (const byte*)&listDut[d];
+        this->Data.insert(this->Data.end(), id, id + RECORD_DUT_SIZE);
+        if (size > 0)
+            this->Data.insert(this->Data.end(), this->Row(dut), this->Row(dut) + size);
+        this->Records++;
+    }
+
+    if (!this->Current.empty())
+        memset(&this->Current[0], 0, this->Current.size());
+}
+
+/******************************************************************************
+    Name:   Save
+    Desc:   Writes the records as they are in memory: magic, record size,
+            record count, then the records
+******************************************************************************/
+int RecordLog::Save(char* filename)
+{
+    DBGTrace("---> RecordLog::Save");
+
+    FILE* file = fopen(filename, "wb");
+
+    if (file == NULL)
+    {
+        String msg;
+        sprintf(msg, "RecordLog could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    int size = RECORD_DUT_SIZE + this->Schema.GetSize();
+
+    fwrite(RECORD_MAGIC, 1, 4, file);
+    fwrite(&size, sizeof(size), 1, file);
+    fwrite(&this->Records, sizeof(this->Records), 1, file);
+    if (!this->Data.empty())
+        fwrite(&this->Data[0], 1, this->Data.size(), file);
+
+    fclose(file);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Export
+    Desc:   Writes the records as text, one line per record, with each
+            column formatted by CUtilities::ToString
+******************************************************************************/
+int RecordLog::Export(char* filename, char* separator)
+{
+    DBGTrace("---> RecordLog::Export");
+
+    FILE* file = fopen(filename, "w");
+
+    if (file == NULL)
+    {
+        String msg;
+        sprintf(msg, "RecordLog could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    String text;
+    qword value;                        // aligned copy of the packed field
+    word dut;
+
+    // header straight to the file, it can be longer than any buffer
+    fprintf(file, "dut");
+    for (int c = 0; c < this->Schema.GetCount(); c++)
+        fprintf(file, "%s%s", separator, (char *)this->Schema.GetColumn(c).label);
+    fprintf(file, "\n");
+
+    for (int r = 0; r < this->Records; r++)
+    {
+        byte* record = this->GetRecord(r);
+
+        memcpy(&dut, record, RECORD_DUT_SIZE);
+        fprintf(file, "%u", dut);
+
+        for (int c = 0; c < this->Schema.GetCount(); c++)
+        {
+            RecordColumn& col = this->Schema.GetColumn(c);
+
+            value = 0;
+            memcpy(&value, record + RECORD_DUT_SIZE + col.offset, col.size);
+            CUtilities::ToString(&value, col.type, col.format, text);
+
+            fprintf(file, "%s%s", separator, (char *)text);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+
+    return SUCCESS;
+}
@@ -0,0 +1,143 @@
+/******************************************************************************
+
+    File:   RecordSchema.h
+    Desc:   Fixed-schema binary test records.  RecordSchema builds the
+            column list once per program from the same label formats and
+            indices FormatString uses for the datalog header, and gives
+            every column a fixed offset in a packed record.  RecordLog then
+            stores one record per DUT per insertion with plain copies, and
+            only Export turns them into text.
+
+            Example:
+
+            RecordSchema schema;
+            int trim = schema.AddColumns(labels, "%s_%s ", 4, byte_type, "%02X", indicies);
+            int vout = schema.AddColumn("vout", double_type, "%7.3f");
+
+            RecordLog log(schema);
+            log.Set(trim + i, dut, value);      // during the run
+            log.Commit(listDut);
+            log.Export("lot.csv", ",");         // at the end of the lot
+
+******************************************************************************/
+#ifndef _RECORD_SCHEMA_H_
+#define _RECORD_SCHEMA_H_
+
+#include <vector>
+
+#include "Defines.h"
+#include "Utilities.h"
+
+#define RECORD_DUT_SIZE         ((int)sizeof(word))     // DUT number before each record
+
+//-----------------------------------------------------------------------------
+//  RecordColumn struct
+typedef struct RecordColumn
+{
+    String          label;
+    String          format;             // passed to CUtilities::ToString
+    variable_type   type;
+    int             offset;             // in the record payload
+    int             size;
+} RecordColumn;
+
+//-----------------------------------------------------------------------------
+//  RecordSchema class definition
+class RecordSchema
+{
+private:
+    vector<RecordColumn> Columns;
+    int Size;                           // payload bytes per record
+    bool Frozen;                        // a RecordLog uses it, no more columns
+
+public:
+    RecordSchema(void);
+    ~RecordSchema(void);
+
+    static int TypeSize(variable_type type);
+
+    int AddColumn(char* label, variable_type type, char* format = "");
+    int AddColumns(String* labels_in, String labelFormat, int count, variable_type type,
+        char* format = "", String* indicies = NULL);
+
+    void Freeze(void) { this->Frozen = true; }
+    bool IsFrozen(void) { return this->Frozen; }
+
+    int GetCount(void) { return (int)this->Columns.size(); }
+    int GetSize(void) { return this->Size; }
+    RecordColumn& GetColumn(int column) { return this->Columns[column]; }
+    int Find(char* label);
+};
+
+//-----------------------------------------------------------------------------
+//  RecordLog class definition
+class RecordLog
+{
+private:
+    RecordSchema& Schema;
+    vector<byte> Current;               // payload per DUT for this insertion
+    vector<byte> Data;                  // committed records
+    int Records;
+
+    RecordLog& operator=(const RecordLog&);
+
+public:
+    RecordLog(RecordSchema& schema);
+    ~RecordLog(void);
+
+    void Clear(void);
+
+    // current payload of a DUT (0 based), NULL for an empty schema
+    byte* Row(int dut)
+    {
+        if (this->Current.empty() || (dut < 0) || (dut >= TOOL_MAX_DUT))
+            return NULL;
+        return &this->Current[dut * this->Schema.GetSize()];
+    }
+
+    // stores a value in a column for a DUT (0 based), converted to the
+    // column type, so a double from the tester can go into a byte column
+    template <typename T>
+    void Set(int column, int dut, T value)
+    {
+        byte* row = this->Row(dut);
+
+        if ((row == NULL) || (column < 0) || (column >= this->Schema.GetCount()))
+            return;
+
+        RecordColumn& col = this->Schema.GetColumn(column);
+        byte* field = row + col.offset;
+
+        switch (col.type)
+        {
+            case bool_type:     { bool v = (value != 0);    memcpy(field, &v, sizeof(v)); break; }
+            case byte_type:
+            case scope_type:    { byte v = (byte)value;     memcpy(field, &v, sizeof(v)); break; }
+            case int_type:      { int v = (int)value;       memcpy(field, &v, sizeof(v)); break; }
+            case uint_type:     { uint v = (uint)value;     memcpy(field, &v, sizeof(v)); break; }
+            case double_type:   { double v = (double)value; memcpy(field, &v, sizeof(v)); break; }
+            case word_type:     { word v = (word)value;     memcpy(field, &v, sizeof(v)); break; }
+            case dword_type:    { dword v = (dword)value;   memcpy(field, &v, sizeof(v)); break; }
+            case qword_type:    { qword v = (qword)value;   memcpy(field, &v, sizeof(v)); break; }
+            default:            break;
+        }
+    }
+
+    // one value per DUT, indexed like the tester arrays ([dut] 0 based)
+    template <typename T>
+    void SetAll(int column, T* values, word* listDut)
+    {
+        for (int d = 0; listDut[d] != 0; d++)
+            this->Set(column, listDut[d] - 1, values[listDut[d] - 1]);
+    }
+
+    void Commit(word* listDut);
+
+    int GetRecords(void) { return this->Records; }
+    byte* GetRecord(int record) { return &this->Data[record * (RECORD_DUT_SIZE + this->Schema.GetSize())]; }
+
+    int Save(char* filename);
+    int Export(char* filename, char* separator = ",");
+};
+
+#endif
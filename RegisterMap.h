@@ -0,0 +1,289 @@
+/******************************************************************************
+
+    File:   RegisterMap.h
+    Desc:   Compile-time register maps.  A map is listed once as an X-macro
+            and REGMAP_DEFINE turns it into a constexpr table, an index enum
+            and a typed accessor per field.  Sort order, overlapping masks
+            and the byte count are checked by static_assert, so a layout
+            mistake fails the build instead of the first insertion, and
+            nothing is built at startup.
+
+            Example:
+
+            #define K_RAM_MAP(X) \
+                X(osc_trim,  PAGE_00, (0x10),       (0x3F),       convert_uint, RAM) \
+                X(osc_en,    PAGE_00, (0x10),       (0x40),       convert_bit,  RAM) \
+                X(gain_trim, PAGE_00, (0x11, 0x12), (0xFF, 0x0F), twos_comp,    RAM)
+
+            REGMAP_DEFINE(KRam, K_RAM_MAP)
+            REGMAP_CHECK_SIZE(KRam, NUM_RAM_REG, NUM_RAM_VALUES)
+
+            int gain = KRam::gain_trim::Get(img, dut);
+
+            Fields must be listed sorted by page and first address (the
+            same order RAMstruct keeps).  For fields spanning several
+            addresses, addr[0] holds the least significant bits, and the
+            masked bits of each byte are packed together in order.
+
+******************************************************************************/
+#ifndef _REGISTER_MAP_H_
+#define _REGISTER_MAP_H_
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+//-----------------------------------------------------------------------------
+//  register field, the static counterpart of ASICregister
+typedef struct RegField
+{
+    const char*     name;
+    byte            page;
+    int             num;                // number of addresses used
+    byte            addr[APP_MAX_ADDR];
+    byte            mask[APP_MAX_ADDR];
+    contype         conversion;
+    mtype           memory;
+} RegField;
+
+//-----------------------------------------------------------------------------
+//  compile-time checks and layout queries
+constexpr int RegKey(const RegField& f, int a)
+{
+    return (f.page << 8) | f.addr[a];
+}
+
+constexpr int RegBits(byte mask)
+{
+    int bits = 0;
+    for (int b = 0; b < 8; b++)
+        bits += (mask >> b) & 1;
+    return bits;
+}
+
+// total masked bits of a field, or of its addresses before a
+constexpr int RegFieldBits(const RegField& f, int before = APP_MAX_ADDR)
+{
+    int bits = 0;
+    for (int a = 0; (a < f.num) && (a < before); a++)
+        bits += RegBits(f.mask[a]);
+    return bits;
+}
+
+constexpr bool RegMapFieldsValid(const RegField* t, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if ( (t[i].num < 1) || (t[i].num > APP_MAX_ADDR) || (RegFieldBits(t[i]) > 32) )
+            return false;
+        for (int a = 0; a < t[i].num; a++)
+        {
+            if ( (t[i].mask[a] == 0) || (t[i].addr[a] == ADDR_INVALID) )
+                return false;
+        }
+    }
+    return true;
+}
+
+constexpr bool RegMapSorted(const RegField* t, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        if (RegKey(t[i - 1], 0) > RegKey(t[i], 0))
+            return false;
+    }
+    return true;
+}
+
+// true if any two fields claim the same bit of the same byte
+constexpr bool RegMapOverlaps(const RegField* t, int n)
+{
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            for (int a = 0; a < t[i].num; a++)
+                for (int b = 0; b < t[j].num; b++)
+                {
+                    if ( (RegKey(t[i], a) == RegKey(t[j], b)) && (t[i].mask[a] & t[j].mask[b]) )
+                        return true;
+                }
+    return false;
+}
+
+// true if byte (i, a) is the first use of its (page, addr) in the table
+constexpr bool RegMapFirstUse(const RegField* t, int i, int a)
+{
+    for (int j = 0; j <= i; j++)
+        for (int b = 0; b < t[j].num; b++)
+        {
+            if ( (j == i) && (b == a) )
+                return true;
+            if (RegKey(t[j], b) == RegKey(t[i], a))
+                return false;
+        }
+    return true;
+}
+
+// number of distinct bytes in the map; pass a key to count only bytes below it
+constexpr int RegMapBytes(const RegField* t, int n, int below = 0x10000)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++)
+        for (int a = 0; a < t[i].num; a++)
+        {
+            if ( RegMapFirstUse(t, i, a) && (RegKey(t[i], a) < below) )
+                count++;
+        }
+    return count;
+}
+
+//-----------------------------------------------------------------------------
+//  decoded value type from bit width
+template <int Bits, bool Signed> struct RegValueType { typedef dword type; };
+template <int Bits> struct RegValueType<Bits, true> { typedef int type; };
+
+#define REGMAP_VALUE_TYPE(bits, s, t) \
+    template <> struct RegValueType<bits, s> { typedef t type; };
+REGMAP_VALUE_TYPE(1, false, byte)  REGMAP_VALUE_TYPE(2, false, byte)
+REGMAP_VALUE_TYPE(3, false, byte)  REGMAP_VALUE_TYPE(4, false, byte)
+REGMAP_VALUE_TYPE(5, false, byte)  REGMAP_VALUE_TYPE(6, false, byte)
+REGMAP_VALUE_TYPE(7, false, byte)  REGMAP_VALUE_TYPE(8, false, byte)
+REGMAP_VALUE_TYPE(9, false, word)  REGMAP_VALUE_TYPE(10, false, word)
+REGMAP_VALUE_TYPE(11, false, word) REGMAP_VALUE_TYPE(12, false, word)
+REGMAP_VALUE_TYPE(13, false, word) REGMAP_VALUE_TYPE(14, false, word)
+REGMAP_VALUE_TYPE(15, false, word) REGMAP_VALUE_TYPE(16, false, word)
+REGMAP_VALUE_TYPE(1, true, signed char)  REGMAP_VALUE_TYPE(2, true, signed char)
+REGMAP_VALUE_TYPE(3, true, signed char)  REGMAP_VALUE_TYPE(4, true, signed char)
+REGMAP_VALUE_TYPE(5, true, signed char)  REGMAP_VALUE_TYPE(6, true, signed char)
+REGMAP_VALUE_TYPE(7, true, signed char)  REGMAP_VALUE_TYPE(8, true, signed char)
+REGMAP_VALUE_TYPE(9, true, short)  REGMAP_VALUE_TYPE(10, true, short)
+REGMAP_VALUE_TYPE(11, true, short) REGMAP_VALUE_TYPE(12, true, short)
+REGMAP_VALUE_TYPE(13, true, short) REGMAP_VALUE_TYPE(14, true, short)
+REGMAP_VALUE_TYPE(15, true, short) REGMAP_VALUE_TYPE(16, true, short)
+
+//-----------------------------------------------------------------------------
+//  per-address access, unrolled at compile time from the last address down
+template <const RegField* T, int N, int I, int A>
+struct RegFieldByte
+{
+    enum
+    {
+        Row = RegMapBytes(T, N, RegKey(T[I], A)),   // row in Image::Raw
+        Shift = RegFieldBits(T[I], A)
+    };
+
+    static dword Get(const byte* raw, int dut)
+    {
+        byte value = raw[(Row * TOOL_MAX_DUT) + dut];
+        byte mask = T[I].mask[A];
+        dword out = 0;
+        int pos = 0;
+
+        // pack the masked bits together
+        for (int b = 0; b < 8; b++)
+        {
+            if (mask & (1 << b))
+                out |= (dword)((value >> b) & 1) << pos++;
+        }
+        return (out << Shift) | RegFieldByte<T, N, I, A - 1>::Get(raw, dut);
+    }
+
+    static void Set(byte* raw, int dut, dword in)
+    {
+        byte& value = raw[(Row * TOOL_MAX_DUT) + dut];
+        byte mask = T[I].mask[A];
+        int pos = Shift;
+
+        for (int b = 0; b < 8; b++)
+        {
+            if (mask & (1 << b))
+                value = (byte)((value & ~(1 << b)) | (((in >> pos++) & 1) << b));
+        }
+        RegFieldByte<T, N, I, A - 1>::Set(raw, dut, in);
+    }
+};
+
+template <const RegField* T, int N, int I>
+struct RegFieldByte<T, N, I, -1>
+{
+    static dword Get(const byte* raw, int dut) { return 0; }
+    static void Set(byte* raw, int dut, dword in) {}
+};
+
+//-----------------------------------------------------------------------------
+//  typed accessor for field I of table T (generated by REGMAP_DEFINE)
+//  raw is laid out like Image::Raw, one row per distinct byte of the map
+template <const RegField* T, int N, int I>
+struct RegFieldRef
+{
+    enum
+    {
+        Bits = RegFieldBits(T[I]),
+        Signed = (T[I].conversion == twos_comp)
+    };
+
+    typedef typename RegValueType<Bits, (Signed != 0)>::type type;
+
+    static const RegField& Field(void) { return T[I]; }
+
+    static type Get(const byte* raw, int dut)
+    {
+        dword value = RegFieldByte<T, N, I, T[I].num - 1>::Get(raw, dut);
+
+        // sign extend two's complement values
+        if (Signed && (Bits < 32) && (value & (1u << (Bits - 1))))
+            value |= ~((1u << Bits) - 1);
+
+        return (type)value;
+    }
+
+    static void Set(byte* raw, int dut, type value)
+    {
+        RegFieldByte<T, N, I, T[I].num - 1>::Set(raw, dut, (dword)value);
+    }
+
+    static type Get(Image& img, int dut) { return Get(&img.Raw[0][0], dut); }
+    static void Set(Image& img, int dut, type value) { Set(&img.Raw[0][0], dut, value); }
+};
+
+//-----------------------------------------------------------------------------
+//  map generation
+#define REGMAP_EXPAND(x)            x
+#define REGMAP_LIST(...)            { __VA_ARGS__ }
+#define REGMAP_NUM_(a, b, c, d, e, f, g, h, N, ...) N
+#define REGMAP_NUM(...)             REGMAP_EXPAND(REGMAP_NUM_(__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0))
+
+#define REGMAP_X_ENUM(name, page, addrs, masks, conv, mem) \
+    name##_index,
+#define REGMAP_X_ENTRY(name, page, addrs, masks, conv, mem) \
+    { #name, page, REGMAP_NUM addrs, REGMAP_LIST addrs, REGMAP_LIST masks, conv, mem },
+#define REGMAP_X_ACCESSOR(name, page, addrs, masks, conv, mem) \
+    typedef RegFieldRef<Table, COUNT, name##_index> name;
+
+#define REGMAP_DEFINE(map, LIST) \
+    namespace map \
+    { \
+        enum Index { LIST(REGMAP_X_ENUM) COUNT }; \
+        static constexpr RegField Table[] = { LIST(REGMAP_X_ENTRY) }; \
+        static_assert(RegMapFieldsValid(Table, COUNT), #map ": field with no mask, bad address or too many bits"); \
+        static_assert(RegMapSorted(Table, COUNT), #map ": fields are not sorted by page and address"); \
+        static_assert(!RegMapOverlaps(Table, COUNT), #map ": two fields share a bit"); \
+        LIST(REGMAP_X_ACCESSOR) \
+    }
+
+// check a map against the image sizes it is used with
+#define REGMAP_CHECK_SIZE(map, num_bytes, num_values) \
+    static_assert(RegMapBytes(map::Table, map::COUNT) == (num_bytes), #map ": wrong number of bytes"); \
+    static_assert(map::COUNT == (num_values), #map ": wrong number of fields");
+
+//-----------------------------------------------------------------------------
+//  bridge for code that still takes a RAMstruct
+inline void RegMapToRAMstruct(const RegField* t, int n, RAMstruct& RAMregisters)
+{
+    for (int i = 0; i < n; i++)
+    {
+        ASICregister reg((char*)t[i].name, t[i].page, (byte*)t[i].addr, (byte*)t[i].mask,
+            convert_type(t[i].conversion), memory_type(t[i].memory), t[i].num);
+        RAMregisters.Add(reg);
+    }
+}
+
+#endif
@@ -0,0 +1,242 @@
+/******************************************************************************
+
+    File:   RegisterShadow.h
+    Desc:   Per-DUT shadow copy of ASIC register contents, so reads and
+            read-modify-writes of values we already know can skip the bus.
+
+            What is cached depends on the memory_type of the register:
+                Volatile    never cached
+                RAM         cached on read or write, until Reset/PowerCycle
+                ROM         cached on read, or on write once Verified
+
+            Register values are passed one row per address, one byte per DUT
+            (values[a * TOOL_MAX_DUT + dut]) just like Image::Raw.  The struct
+            is large, so keep it static or on the heap.
+
+******************************************************************************/
+#ifndef _REGISTER_SHADOW_H_
+#define _REGISTER_SHADOW_H_
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+#ifndef SHADOW_MAX_PAGES
+#define SHADOW_MAX_PAGES        4
+#endif
+
+#define SHADOW_MAX_ADDR         256
+
+// state of one (page, addr) byte for one DUT
+#define SHADOW_INVALID          0
+#define SHADOW_VALID            1
+#define SHADOW_PROGRAMMED       2       // ROM written, waiting on verify
+
+//-----------------------------------------------------------------------------
+//  RegisterShadow struct
+typedef struct RegisterShadow
+{
+    byte            value[SHADOW_MAX_PAGES][SHADOW_MAX_ADDR][TOOL_MAX_DUT];
+    byte            state[SHADOW_MAX_PAGES][SHADOW_MAX_ADDR][TOOL_MAX_DUT];
+    byte            memory[SHADOW_MAX_PAGES][SHADOW_MAX_ADDR];  // mtype last seen
+    dword           hits;
+    dword           misses;
+
+    RegisterShadow(void)
+    {
+        Invalidate();
+    }
+
+    // drop everything, including ROM
+    void Invalidate(void)
+    {
+        memset(value, 0x00, sizeof(value));
+        memset(state, SHADOW_INVALID, sizeof(state));
+        memset(memory, Volatile, sizeof(memory));
+        hits = 0;
+        misses = 0;
+    }
+
+    // RAM contents are lost on reset; ROM survives
+    void Reset(word* listDut)
+    {
+        int dut;
+
+        for (int p = 0; p < SHADOW_MAX_PAGES; p++)
+        {
+            for (int a = 0; a < SHADOW_MAX_ADDR; a++)
+            {
+                if (memory[p][a] == ROM)
+                    continue;
+
+                for (int d = 0; listDut[d] != 0; d++)
+                {
+                    dut = listDut[d] - 1;
+                    state[p][a][dut] = SHADOW_INVALID;
+                }
+            }
+        }
+    }
+
+    void PowerCycle(word* listDut)
+    {
+        Reset(listDut);
+    }
+
+    // true (and values filled) only if the byte is valid for every DUT
+    bool Lookup(byte page, byte addr, mtype mem, byte* values, word* listDut)
+    {
+        int dut;
+
+        if ( (mem == Volatile) || (page >= SHADOW_MAX_PAGES) )
+        {
+            misses++;
+            return false;
+        }
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            if (state[page][addr][dut] != SHADOW_VALID)
+            {
+                misses++;
+                return false;
+            }
+        }
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            values[dut] = value[page][addr][dut];
+        }
+
+        hits++;
+        return true;
+    }
+
+    // true (and values filled for all of its addresses) if the whole register is cached
+    bool Lookup(ASICregister& reg, byte* values, word* listDut)
+    {
+        for (int a = 0; (a < APP_MAX_ADDR) && (reg.addr[a] != ADDR_INVALID); a++)
+        {
+            if (!Lookup(reg.page, reg.addr[a], reg.memory.type, &values[a * TOOL_MAX_DUT], listDut))
+                return false;
+        }
+        return true;
+    }
+
+    // record values just read from hardware
+    void Fill(byte page, byte addr, mtype mem, byte* values, word* listDut)
+    {
+        if ( (mem == Volatile) || (page >= SHADOW_MAX_PAGES) )
+            return;
+
+        Store(page, addr, mem, values, SHADOW_VALID, listDut);
+    }
+
+    void Fill(ASICregister& reg, byte* values, word* listDut)
+    {
+        for (int a = 0; (a < APP_MAX_ADDR) && (reg.addr[a] != ADDR_INVALID); a++)
+            Fill(reg.page, reg.addr[a], reg.memory.type, &values[a * TOOL_MAX_DUT], listDut);
+    }
+
+    // record values just written to hardware
+    void Written(byte page, byte addr, mtype mem, byte* values, word* listDut)
+    {
+        if (page >= SHADOW_MAX_PAGES)
+            return;
+
+        switch (mem)
+        {
+        case RAM:
+            Store(page, addr, mem, values, SHADOW_VALID, listDut);
+            break;
+
+        case ROM:
+            Store(page, addr, mem, values, SHADOW_PROGRAMMED, listDut);
+            break;
+
+        default:
+            Store(page, addr, mem, values, SHADOW_INVALID, listDut);
+            break;
+        }
+    }
+
+    void Written(ASICregister& reg, byte* values, word* listDut)
+    {
+        for (int a = 0; (a < APP_MAX_ADDR) && (reg.addr[a] != ADDR_INVALID); a++)
+            Written(reg.page, reg.addr[a], reg.memory.type, &values[a * TOOL_MAX_DUT], listDut);
+    }
+
+    // after a ROM program is verified, keep the DUTs that passed
+    void Verified(byte page, byte addr, bool* result, word* listDut)
+    {
+        int dut;
+
+        if (page >= SHADOW_MAX_PAGES)
+            return;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            if (state[page][addr][dut] == SHADOW_PROGRAMMED)
+                state[page][addr][dut] = (result[dut] ? SHADOW_VALID : SHADOW_INVALID);
+        }
+    }
+
+    void Verified(ASICregister& reg, bool* result, word* listDut)
+    {
+        for (int a = 0; (a < APP_MAX_ADDR) && (reg.addr[a] != ADDR_INVALID); a++)
+            Verified(reg.page, reg.addr[a], result, listDut);
+    }
+
+    // builds the byte to write for a masked update without reading the
+    // hardware.  Returns false if the current value is not cached.
+    bool ReadModifyWrite(byte page, byte addr, mtype mem, byte mask,
+        byte* bits, byte* output, word* listDut)
+    {
+        int dut;
+        byte current[TOOL_MAX_DUT];
+
+        if (!Lookup(page, addr, mem, current, listDut))
+            return false;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            output[dut] = (byte)((current[dut] & ~mask) | (bits[dut] & mask));
+        }
+        return true;
+    }
+
+    void Print(void)
+    {
+        String msg;
+        dword total = hits + misses;
+
+        sprintf(msg, "\nRegisterShadow: %u hits, %u misses (%.1f%% hit rate)", hits, misses,
+            (total > 0) ? (100.0 * hits / total) : 0.0);
+
+        // always display
+        bool was_on = DBGVerboseEnabled;
+        DBGVerboseEnabled = YES;
+        DBGVerbose(msg);
+        DBGVerboseEnabled = was_on;
+    }
+
+private:
+    void Store(byte page, byte addr, mtype mem, byte* values, byte new_state, word* listDut)
+    {
+        int dut;
+
+        memory[page][addr] = (byte)mem;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            value[page][addr][dut] = values[dut];
+            state[page][addr][dut] = new_state;
+        }
+    }
+} RegisterShadow;
+
+#endif
@@ -13,6 +13,8 @@
 #include <functional>
 
 #include "Defines.h"
+#include "ScratchArena.h"
+#include "ViewRing.h"
 
 //-----------------------------------------------------------------------------
 // conversion types
@@ -540,9 +542,10 @@ typedef struct Default
     void Compare(byte* Raw, byte* difference, bool* result, word* listDut)
     {
         int dut, index;
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
+        ScratchScope scratch;
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
         
-        memset(diff, 0x00, sizeof(diff));
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         // Note: memset will not set a boolean array to true correctly
         // If the spec image doesn't match for at least one byte, result will be false for that dut
@@ -562,15 +565,16 @@ typedef struct Default
                 }
             }
         }
-        memcpy(difference, diff, sizeof(diff));
+        memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
     }
     
     void CompareMasked(byte* Raw, byte* difference, bool* result, word* listDut)
     {
         int dut, index;
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
+        ScratchScope scratch;
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
         
-        memset(diff, 0x00, sizeof(diff));
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         for (int i = 0; i < TOOL_MAX_DUT; i++)
             result[i] = true;
@@ -588,7 +592,7 @@ typedef struct Default
                 }
             }
         }
-        memcpy(difference, diff, sizeof(diff));
+        memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
     }
     
     void Print(void)
@@ -609,6 +613,33 @@ typedef struct Default
     }
 } Default;
 
+//-----------------------------------------------------------------------------
+//  change tracking for CompareIncremental.  Writes stamp their row from one
+//  counter shared by every image, so a stamp is never reused by another
+//  image at the same address.
+inline dword ImageStamp(void)
+{
+    static dword stamp = 0;
+    return ++stamp;
+}
+
+// copies listDut to tracked, true if it was a different list
+inline bool TrackDutList(word* tracked, word* listDut)
+{
+    int d;
+    bool changed = false;
+    
+    for (d = 0; listDut[d] != 0; d++)
+    {
+        changed = changed || (tracked[d] != listDut[d]);
+        tracked[d] = listDut[d];
+    }
+    changed = changed || (tracked[d] != 0);
+    tracked[d] = 0;
+    
+    return changed;
+}
+
 //-----------------------------------------------------------------------------
 //  Image struct
 //  Used for storing, comparing, and displaying RAM and ROM images
@@ -619,23 +650,69 @@ typedef struct Image
     memory_type     memory;
     byte            page;
     
-    Image(void) {}
+    // change tracking for CompareIncremental
+    dword           RowStamp[NUM_RAM_REG];              // ImageStamp of the last write to each row
+    byte            LastDiff[NUM_RAM_REG][TOOL_MAX_DUT];
+    int             Mismatch[TOOL_MAX_DUT];             // rows in LastDiff that differ
+    const void*     TrackedRef;                         // reference LastDiff is against
+    dword           TrackedStamp;                       // ImageStamp of the last compare
+    word            TrackedDuts[TOOL_MAX_DUT + 1];      // listDut of the last compare
+    byte            SpecCopy[NUM_RAM_REG];              // Default spec at the last compare
+    
+    Image(void) { MarkAllDirty(); }
     
     Image(mtype mem_in, byte page_in) : memory(mem_in), page(page_in)
     {
         memset(Raw, 0x00, sizeof(Raw));
         memset(Converted, 0, sizeof(Converted));
+        MarkAllDirty();
     }
     
     Image(mtype mem_in, byte page_in, byte* raw_in) : memory(mem_in), page(page_in)
     {
         memcpy(Raw, raw_in, sizeof(Raw));
         memset(Converted, 0, sizeof(Converted));
+        MarkAllDirty();
     }
     
     void SetRaw(byte* raw_in)
     {
         memcpy(Raw, raw_in, sizeof(Raw));
+        MarkAllDirty();
+    }
+    
+    // write path: set one register row for the DUTs in listDut
+    void Write(int reg, byte* values, word* listDut)
+    {
+        int dut;
+        
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            Raw[reg][dut] = values[dut];
+        }
+        RowStamp[reg] = ImageStamp();
+    }
+    
+    // flag rows low through high as changed, after writing Raw directly
+    void MarkDirty(int low, int high)
+    {
+        dword stamp = ImageStamp();
+        
+        for (int i = low; (i <= high) && (i < NUM_RAM_REG); i++)
+            RowStamp[i] = stamp;
+    }
+    
+    // flag every row as changed and forget the last compare, the next
+    // incremental compare of this image, or against it, is full
+    void MarkAllDirty(void)
+    {
+        dword stamp = ImageStamp();
+        
+        for (int i = 0; i < NUM_RAM_REG; i++)
+            RowStamp[i] = stamp;
+        TrackedRef = NULL;
+        TrackedDuts[0] = 0;
     }
     
     // convert raw register values from byte to int using RAMstruct
@@ -648,11 +725,12 @@ typedef struct Image
     void Compare(byte* otherRaw, byte* difference, bool* result, word* listDut)
     {
         int dut, index;
-        String temp[TOOL_MAX_DUT];
         char msg[APP_MAX_CHAR_LONGER];
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
+        ScratchScope scratch;
+        String* temp = scratch.New<String>(TOOL_MAX_DUT);
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
         
-        memset(diff, 0x00, sizeof(diff));
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         for (int i = 0; i < TOOL_MAX_DUT; i++)
             result[i] = true;
@@ -682,18 +760,19 @@ typedef struct Image
         }
         
         if (difference != NULL)
-            memcpy(difference, diff, sizeof(diff));
+            memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
     }
     
     // compare images
-    void Compare(Image img, byte* difference, bool* result, word* listDut)
+    void Compare(Image& img, byte* difference, bool* result, word* listDut)
     {
         int dut;
-        String temp[TOOL_MAX_DUT];
         char msg[APP_MAX_CHAR_LONGER];
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
+        ScratchScope scratch;
+        String* temp = scratch.New<String>(TOOL_MAX_DUT);
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
         
-        memset(diff, 0x00, sizeof(diff));
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         for (int i = 0; i < TOOL_MAX_DUT; i++)
             result[i] = true;
@@ -722,13 +801,14 @@ typedef struct Image
         }
         
         if (difference != NULL)
-            memcpy(difference, diff, sizeof(diff));
+            memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
     }
     
-    void CompareDefault(Default DefaultImg, byte* difference, bool* result, word* listDut)
+    void CompareDefault(Default& DefaultImg, byte* difference, bool* result, word* listDut)
     {
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
-        memset(diff, 0x00, sizeof(diff));
+        ScratchScope scratch;
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         DefaultImg.Compare(&Raw[0][0], &diff[0][0], result, listDut);
         
@@ -736,7 +816,8 @@ typedef struct Image
         if (DBGVerboseEnabled)
         {
             int dut;
-            String temp[TOOL_MAX_DUT];
+            ScratchScope scratch;
+            String* temp = scratch.New<String>(TOOL_MAX_DUT);
             char msg[APP_MAX_CHAR_LONGER] = "";
             
             B2SArray(&temp[0], &diff[0][0], NUM_RAM_REG, listDut);
@@ -755,17 +836,18 @@ typedef struct Image
         }
         
         if (difference != NULL)
-            memcpy(difference, diff, sizeof(diff));
+            memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
     }
     
-    void CompareMaskedDefault(Default DefaultImg, byte* difference, bool* result, word* listDut)
+    void CompareMaskedDefault(Default& DefaultImg, byte* difference, bool* result, word* listDut)
     {
         int dut;
-        String temp[TOOL_MAX_DUT];
         char msg[APP_MAX_CHAR_LONGER];
         
-        byte diff[NUM_RAM_REG][TOOL_MAX_DUT];
-        memset(diff, 0x00, sizeof(diff));
+        ScratchScope scratch;
+        String* temp = scratch.New<String>(TOOL_MAX_DUT);
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(NUM_RAM_REG);
+        memset(diff, 0x00, NUM_RAM_REG * TOOL_MAX_DUT);
         
         DefaultImg.CompareMasked(&Raw[0][0], &diff[0][0], result, listDut);
         
@@ -784,7 +866,110 @@ typedef struct Image
         }
         
         if (difference != NULL)
-            memcpy(difference, diff, sizeof(diff));
+            memcpy(difference, diff, NUM_RAM_REG * TOOL_MAX_DUT);
+    }
+    
+    // compare only the rows that changed in either image since the last
+    // incremental compare against the same reference with the same listDut,
+    // carrying forward the result of the rest.  A raw buffer has no row
+    // stamps, so it is compared in full with Compare.  A Default has none
+    // either and is checked against a copy of its spec.
+    void CompareIncremental(Image& img, byte* difference, bool* result, word* listDut)
+    {
+        UpdateDiff(&img, &img.Raw[0][0], TOOL_MAX_DUT, 1, img.RowStamp, result, listDut);
+        PrintDiff(img.memory.name, difference, result, listDut);
+    }
+    
+    void CompareDefaultIncremental(Default& DefaultImg, byte* difference, bool* result, word* listDut)
+    {
+        UpdateDiff(&DefaultImg, DefaultImg.SpecImage, 1, 0, NULL, result, listDut);
+        PrintDiff("Default", difference, result, listDut);
+    }
+    
+    // recompute LastDiff for changed rows.  Rows of ref are row_stride apart
+    // and DUTs dut_stride apart (0 when every DUT shares one spec byte).
+    // refStamp are the row stamps of ref, or NULL for a Default spec
+    // (one byte per row), which is checked against SpecCopy.
+    void UpdateDiff(const void* id, byte* ref, int row_stride, int dut_stride,
+        dword* refStamp, bool* result, word* listDut)
+    {
+        int dut;
+        byte now;
+        bool full = (id != TrackedRef);
+        
+        // a DUT added to listDut has never been compared
+        if (TrackDutList(TrackedDuts, listDut))
+            full = true;
+        
+        if (full)
+        {
+            memset(LastDiff, 0x00, sizeof(LastDiff));
+            memset(Mismatch, 0, sizeof(Mismatch));
+            TrackedRef = id;
+        }
+        
+        for (int i = 0; i < NUM_RAM_REG; i++)
+        {
+            byte* row = &ref[i * row_stride];
+            
+            if ( !full && (RowStamp[i] <= TrackedStamp) )
+            {
+                if ( (refStamp != NULL) ? (refStamp[i] <= TrackedStamp)
+                                        : (row[0] == SpecCopy[i]) )
+                    continue;
+            }
+            
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                now = (byte)(Raw[i][dut] ^ row[dut * dut_stride]);
+                
+                Mismatch[dut] += (now != 0) - (LastDiff[i][dut] != 0);
+                LastDiff[i][dut] = now;
+            }
+            
+            if (refStamp == NULL)
+                SpecCopy[i] = row[0];
+        }
+        TrackedStamp = ImageStamp();
+        
+        for (int i = 0; i < TOOL_MAX_DUT; i++)
+            result[i] = true;
+        
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            result[dut] = (Mismatch[dut] == 0);
+        }
+    }
+    
+    // debug output of LastDiff and copy to difference
+    void PrintDiff(char* other, byte* difference, bool* result, word* listDut)
+    {
+        if (DBGVerboseEnabled)
+        {
+            int dut;
+            ScratchScope scratch;
+            String* temp = scratch.New<String>(TOOL_MAX_DUT);
+            char msg[APP_MAX_CHAR_LONGER] = "";
+            
+            B2SArray(&temp[0], &LastDiff[0][0], NUM_RAM_REG, listDut);
+            
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                
+                if (result[dut] == false)
+                {
+                    sprintf_s(msg, APP_MAX_CHAR_LONGER, "\n%sImage diff %sImage [%i]: ", (char*)memory.name, other, dut);
+                    strcat_s(msg, APP_MAX_CHAR_LONGER, temp[dut]);
+                    DBGVerbose(msg);
+                }
+            }
+        }
+        
+        if (difference != NULL)
+            memcpy(difference, LastDiff, sizeof(LastDiff));
     }
     
     // print raw image for 1 DUT
@@ -865,12 +1050,18 @@ typedef struct Image
     
     void View(int dut)
     {
-        CTestbench::LVImageView(B2S(&Raw[0][dut], NUM_RAM_REG),page);
+        if (ViewRing::GetPublisher() != NULL)
+            ViewRing::GetPublisher()->Publish(page, dut, &Raw[0][dut], NULL, NUM_RAM_REG);
+        else
+            CTestbench::LVImageView(B2S(&Raw[0][dut], NUM_RAM_REG),page);
     }
     
-    void View(Image Img, int dut)
+    void View(Image& Img, int dut)
     {
-        CTestbench::LVImageView(B2S(&Raw[0][dut], NUM_RAM_REG), B2S(&Img.Raw[0][dut], NUM_RAM_REG), page);
+        if (ViewRing::GetPublisher() != NULL)
+            ViewRing::GetPublisher()->Publish(page, dut, &Raw[0][dut], &Img.Raw[0][dut], NUM_RAM_REG);
+        else
+            CTestbench::LVImageView(B2S(&Raw[0][dut], NUM_RAM_REG), B2S(&Img.Raw[0][dut], NUM_RAM_REG), page);
     }
 } Image;
 
@@ -884,12 +1075,22 @@ typedef struct VolImage
     byte            page;              // needs to be defined for LV front panel
     int             count;             // number of registers in image
     
+    // change tracking for CompareIncremental, as in Image
+    dword           RowStamp[MAX_PAGE_SIZE];
+    byte            LastDiff[MAX_PAGE_SIZE][TOOL_MAX_DUT];
+    int             Mismatch[TOOL_MAX_DUT];
+    const void*     TrackedRef;
+    dword           TrackedStamp;
+    int             TrackedCount;
+    word            TrackedDuts[TOOL_MAX_DUT + 1];
+    
     VolImage(void)
     {
         page = PAGE_00;
         memory = Volatile;
         memset(Raw, 0x00, sizeof(Raw));
         count = 0;
+        MarkAllDirty();
     }
     
     VolImage(byte page_in) : page(page_in)
@@ -897,34 +1098,70 @@ typedef struct VolImage
         memory = Volatile;
         memset(Raw, 0x00, sizeof(Raw));
         count = 0;
+        MarkAllDirty();
     }
     
     VolImage(byte page_in, int size) : page(page_in), count(size)
     {
         memory = Volatile;
         memset(Raw, 0x00, sizeof(Raw));
+        MarkAllDirty();
     }
     
     VolImage(byte page_in, byte* array_in, int size) : page(page_in), count(size)
     {
         memory = Volatile;
         memcpy(Raw, array_in, sizeof(Raw));
+        MarkAllDirty();
     }
     
     void SetRaw(byte* raw_in, int size)
     {
         memcpy(Raw, raw_in, sizeof(Raw));
         count = size;
+        MarkAllDirty();
+    }
+    
+    // write path: set one register row for the DUTs in listDut
+    void Write(int reg, byte* values, word* listDut)
+    {
+        int dut;
+        
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            Raw[reg][dut] = values[dut];
+        }
+        RowStamp[reg] = ImageStamp();
+    }
+    
+    void MarkDirty(int low, int high)
+    {
+        dword stamp = ImageStamp();
+        
+        for (int i = low; (i <= high) && (i < MAX_PAGE_SIZE); i++)
+            RowStamp[i] = stamp;
+    }
+    
+    void MarkAllDirty(void)
+    {
+        dword stamp = ImageStamp();
+        
+        for (int i = 0; i < MAX_PAGE_SIZE; i++)
+            RowStamp[i] = stamp;
+        TrackedRef = NULL;
+        TrackedDuts[0] = 0;
     }
     
-    void Compare(VolImage img, byte* difference, bool* result, word* listDut)
+    void Compare(VolImage& img, byte* difference, bool* result, word* listDut)
     {
         int dut;
-        String temp[TOOL_MAX_DUT];
         char msg[APP_MAX_CHAR_LONGER];
-        byte diff[MAX_PAGE_SIZE][TOOL_MAX_DUT];
+        ScratchScope scratch;
+        String* temp = scratch.New<String>(TOOL_MAX_DUT);
+        byte (*diff)[TOOL_MAX_DUT] = scratch.Alloc<byte[TOOL_MAX_DUT]>(MAX_PAGE_SIZE);
         
-        memset(diff, 0x00, sizeof(diff));
+        memset(diff, 0x00, MAX_PAGE_SIZE * TOOL_MAX_DUT);
         
         for (int i = 0; i < TOOL_MAX_DUT; i++)
             result[i] = true;
@@ -953,7 +1190,77 @@ typedef struct VolImage
         }
         
         if (difference != NULL)
-            memcpy(difference, diff, sizeof(diff));
+            memcpy(difference, diff, MAX_PAGE_SIZE * TOOL_MAX_DUT);
+    }
+    
+    // compare only the rows that changed in either image since the last
+    // incremental compare against img with the same listDut and count,
+    // carrying forward the rest.  Use Compare for a full compare.
+    void CompareIncremental(VolImage& img, byte* difference, bool* result, word* listDut)
+    {
+        int dut;
+        byte now;
+        bool full = ((const void*)&img != TrackedRef) || (count != TrackedCount);
+        
+        if (TrackDutList(TrackedDuts, listDut))
+            full = true;
+        
+        if (full)
+        {
+            memset(LastDiff, 0x00, sizeof(LastDiff));
+            memset(Mismatch, 0, sizeof(Mismatch));
+            TrackedRef = &img;
+            TrackedCount = count;
+        }
+        
+        for (int i = 0; i < count; i++)
+        {
+            if ( !full && (RowStamp[i] <= TrackedStamp) && (img.RowStamp[i] <= TrackedStamp) )
+                continue;
+            
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                now = (byte)(Raw[i][dut] ^ img.Raw[i][dut]);
+                
+                Mismatch[dut] += (now != 0) - (LastDiff[i][dut] != 0);
+                LastDiff[i][dut] = now;
+            }
+        }
+        TrackedStamp = ImageStamp();
+        
+        for (int i = 0; i < TOOL_MAX_DUT; i++)
+            result[i] = true;
+        
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            result[dut] = (Mismatch[dut] == 0);
+        }
+        
+        if (DBGVerboseEnabled)
+        {
+            ScratchScope scratch;
+            String* temp = scratch.New<String>(TOOL_MAX_DUT);
+            char msg[APP_MAX_CHAR_LONGER] = "";
+            
+            B2SArray(&temp[0], &LastDiff[0][0], count, listDut);
+            
+            for (int d = 0; listDut[d] != 0; d++)
+            {
+                dut = listDut[d] - 1;
+                
+                if (result[dut] == false)
+                {
+                    sprintf_s(msg, APP_MAX_CHAR_LONGER, "\n%sImage diff %sImage [%i]: ", (char*)memory.name, (char*)img.memory.name, dut);
+                    strcat_s(msg, APP_MAX_CHAR_LONGER, temp[dut]);
+                    DBGVerbose(msg);
+                }
+            }
+        }
+        
+        if (difference != NULL)
+            memcpy(difference, LastDiff, sizeof(LastDiff));
     }
     
     // print raw image for 1 DUT
@@ -984,12 +1291,18 @@ typedef struct VolImage
     
     void View(int dut)
     {
-        CTestbench::LVImageView(B2S(&Raw[0][dut], count),page);
+        if (ViewRing::GetPublisher() != NULL)
+            ViewRing::GetPublisher()->Publish(page, dut, &Raw[0][dut], NULL, count);
+        else
+            CTestbench::LVImageView(B2S(&Raw[0][dut], count),page);
     }
     
-    void View(Image Img, int dut)
+    void View(Image& Img, int dut)
     {
-        CTestbench::LVImageView(B2S(&Raw[0][dut], count), B2S(&Img.Raw[0][dut], count), page);
+        if (ViewRing::GetPublisher() != NULL)
+            ViewRing::GetPublisher()->Publish(page, dut, &Raw[0][dut], &Img.Raw[0][dut], count);
+        else
+            CTestbench::LVImageView(B2S(&Raw[0][dut], count), B2S(&Img.Raw[0][dut], count), page);
     }
 } VolImage;
 
@@ -0,0 +1,175 @@
+/******************************************************************************
+
+    File:   ScratchArena.h
+    Desc:   Bump allocator for temporary buffers (diff matrices, string
+            arrays) that would otherwise be large stack frames.  Functions
+            that need scratch space take a ScratchScope, so their buffers,
+            and any heap block used when the arena was full, are handed back
+            as soon as they return.
+
+            Objects from New() are never destroyed, so New() only accepts
+            trivially destructible types (byte arrays, String).  Not thread
+            safe; the test flow is single threaded.
+
+******************************************************************************/
+#ifndef _SCRATCH_ARENA_H_
+#define _SCRATCH_ARENA_H_
+
+#include <new>
+#include <vector>
+#include <cstdlib>
+#include <type_traits>
+
+#include "Defines.h"
+
+#ifndef SCRATCH_DEFAULT_SIZE
+#define SCRATCH_DEFAULT_SIZE    (4 * 1024 * 1024)
+#endif
+
+#define SCRATCH_ALIGN           16
+
+//-----------------------------------------------------------------------------
+//  ScratchMark struct
+//  Arena position to release back to
+typedef struct ScratchMark
+{
+    size_t          used;               // bytes used in the buffer
+    size_t          overflow;           // heap blocks in use
+} ScratchMark;
+
+//-----------------------------------------------------------------------------
+//  ScratchArena class
+class ScratchArena
+{
+private:
+    unsigned char* Buffer;
+    size_t Capacity;
+    size_t Used;
+    size_t Peak;
+    std::vector<void*> Overflow;        // heap blocks used when Buffer is full
+
+    ScratchArena(const ScratchArena&);
+    ScratchArena& operator=(const ScratchArena&);
+
+public:
+    ScratchArena(size_t size = SCRATCH_DEFAULT_SIZE)
+        : Capacity(size), Used(0), Peak(0)
+    {
+        Buffer = (unsigned char*)malloc(size);
+        if (Buffer == NULL)
+            Capacity = 0;
+    }
+
+    ~ScratchArena(void)
+    {
+        Reset();
+        free(Buffer);
+    }
+
+    // arena shared by everything in the current test step
+    static ScratchArena& Step(void)
+    {
+        static ScratchArena arena;
+        return arena;
+    }
+
+    void* Alloc(size_t bytes)
+    {
+        size_t start = (Used + SCRATCH_ALIGN - 1) & ~(size_t)(SCRATCH_ALIGN - 1);
+
+        if (start + bytes > Capacity)
+        {
+            // keep going, but the arena should be sized so this never happens
+            void* block = malloc(bytes);
+            if (block == NULL)
+            {
+                ERRCrit(ERROR_RUN, "ScratchArena could not allocate an overflow block.");
+                return NULL;
+            }
+            Overflow.push_back(block);
+            return block;
+        }
+
+        Used = start + bytes;
+        if (Used > Peak)
+            Peak = Used;
+
+        return &Buffer[start];
+    }
+
+    template <typename T> T* Alloc(size_t count)
+    {
+        return (T*)Alloc(sizeof(T) * count);
+    }
+
+    // allocate and default construct count objects, never destroyed
+    template <typename T> T* New(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "ScratchArena::New objects are never destroyed");
+
+        T* p = Alloc<T>(count);
+        if (p == NULL)
+            return NULL;
+
+        for (size_t i = 0; i < count; i++)
+            new (&p[i]) T();
+        return p;
+    }
+
+    ScratchMark Mark(void)
+    {
+        ScratchMark mark = { Used, Overflow.size() };
+        return mark;
+    }
+
+    // hand back everything allocated since mark, heap blocks included
+    void Release(ScratchMark mark)
+    {
+        if (mark.used < Used)
+            Used = mark.used;
+
+        while (Overflow.size() > mark.overflow)
+        {
+            free(Overflow.back());
+            Overflow.pop_back();
+        }
+    }
+
+    // O(1) unless an overflow block is still held
+    void Reset(void)
+    {
+        Used = 0;
+        for (size_t i = 0; i < Overflow.size(); i++)
+            free(Overflow[i]);
+        Overflow.clear();
+    }
+
+    size_t GetPeak(void) { return Peak; }
+    size_t GetOverflows(void) { return Overflow.size(); }
+};
+
+//-----------------------------------------------------------------------------
+//  ScratchScope class
+//  Hands everything allocated through it back to the arena when it goes out
+//  of scope.
+class ScratchScope
+{
+private:
+    ScratchArena& Arena;
+    ScratchMark Start;
+
+    ScratchScope(const ScratchScope&);
+    ScratchScope& operator=(const ScratchScope&);
+
+public:
+    ScratchScope(ScratchArena& arena = ScratchArena::Step())
+        : Arena(arena), Start(arena.Mark()) {}
+
+    ~ScratchScope(void) { Arena.Release(Start); }
+
+    template <typename T> T* Alloc(size_t count) { return Arena.Alloc<T>(count); }
+    template <typename T> T* New(size_t count) { return Arena.New<T>(count); }
+};
+
+#endif
@@ -0,0 +1,272 @@
+/******************************************************************************
+
+    File:   SlicedImage.h
+    Desc:   Bit-sliced (transposed) register image.  Instead of one byte per
+            (register, DUT) as in Image::Raw, each (register, bit) holds one
+            bit per DUT in DUT lanes, 64 DUTs per word.  A masked compare,
+            a status flag across all DUTs or the fail count of a register
+            bit is then a few word operations per register instead of a
+            loop over the DUTs.
+
+            The transpose kernels convert one [row][TOOL_MAX_DUT] byte row
+            at a time, 8 DUTs per 8x8 bit transpose.  Byte rows are loaded
+            as little-endian words.
+
+            Example:
+
+            static SlicedImage sliced;
+            DutLanes active, fail;
+            sliced.Load(&img.Raw[0][0], NUM_RAM_REG);
+            active.Set(listDut);
+            sliced.CompareMasked(spec, active, fail);
+            fail.ToResult(result);
+
+******************************************************************************/
+#ifndef _SLICED_IMAGE_H_
+#define _SLICED_IMAGE_H_
+
+#include "Defines.h"
+#include "Utilities.h"
+#include "RegisterTypeDefs.h"
+
+#define SLICE_LANES             ((TOOL_MAX_DUT + 63) / 64)
+#define SLICE_GROUPS            ((TOOL_MAX_DUT + 7) / 8)
+#define SLICE_MAX_ROWS          ((NUM_RAM_REG > MAX_PAGE_SIZE) ? NUM_RAM_REG : MAX_PAGE_SIZE)
+
+//-----------------------------------------------------------------------------
+//  one bit per DUT (0 based), 64 DUTs per word
+typedef struct DutLanes
+{
+    qword           lane[SLICE_LANES];
+
+    DutLanes(void) { Clear(); }
+
+    void Clear(void) { memset(lane, 0, sizeof(lane)); }
+
+    void Set(word* listDut)
+    {
+        Clear();
+        for (int d = 0; listDut[d] != 0; d++)
+            lane[(listDut[d] - 1) >> 6] |= (qword)1 << ((listDut[d] - 1) & 63);
+    }
+
+    bool Test(int dut) { return ((lane[dut >> 6] >> (dut & 63)) & 1) != 0; }
+
+    bool Any(void)
+    {
+        qword any = 0;
+        for (int l = 0; l < SLICE_LANES; l++)
+            any |= lane[l];
+        return (any != 0);
+    }
+
+    int Count(void)
+    {
+        int count = 0;
+        for (int l = 0; l < SLICE_LANES; l++)
+            count += CUtilities::PopCount(lane[l]);
+        return count;
+    }
+
+    // result[dut] as from a compare: false where the lane is set
+    void ToResult(bool* result)
+    {
+        for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+            result[dut] = !Test(dut);
+    }
+
+    // flags[dut] true where the lane is set
+    void ToFlags(bool* flags)
+    {
+        for (int dut = 0; dut < TOOL_MAX_DUT; dut++)
+            flags[dut] = Test(dut);
+    }
+} DutLanes;
+
+//-----------------------------------------------------------------------------
+//  transpose kernels
+
+// transpose an 8x8 bit matrix: bit j of byte i moves to bit i of byte j
+inline qword SliceTranspose8(qword x)
+{
+    qword t;
+
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+    x ^= t ^ (t << 28);
+
+    return x;
+}
+
+// one byte row (row[dut]) into 8 bit planes of DUT lanes
+inline void SliceRow(const byte* row, qword (*planes)[SLICE_LANES])
+{
+    qword x;
+
+    memset(planes, 0, 8 * SLICE_LANES * sizeof(qword));
+
+    for (int g = 0; g < SLICE_GROUPS; g++)
+    {
+        x = 0;
+        memcpy(&x, &row[g * 8], ((g + 1) * 8 <= TOOL_MAX_DUT) ? 8 : (TOOL_MAX_DUT - g * 8));
+
+        if (x == 0)
+            continue;
+
+        x = SliceTranspose8(x);
+
+        for (int b = 0; b < 8; b++)
+            planes[b][g >> 3] |= ((x >> (8 * b)) & 0xFF) << ((g & 7) * 8);
+    }
+}
+
+// 8 bit planes of DUT lanes back into one byte row
+inline void UnsliceRow(const qword (*planes)[SLICE_LANES], byte* row)
+{
+    qword x;
+
+    for (int g = 0; g < SLICE_GROUPS; g++)
+    {
+        x = 0;
+        for (int b = 0; b < 8; b++)
+            x |= ((planes[b][g >> 3] >> ((g & 7) * 8)) & 0xFF) << (8 * b);
+
+        x = SliceTranspose8(x);
+
+        memcpy(&row[g * 8], &x, ((g + 1) * 8 <= TOOL_MAX_DUT) ? 8 : (TOOL_MAX_DUT - g * 8));
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  SlicedImage struct
+//  Bits[reg][bit] holds that register bit for every DUT.  Large, keep it
+//  static or in a pool like Image.
+typedef struct SlicedImage
+{
+    qword           Bits[SLICE_MAX_ROWS][8][SLICE_LANES];
+    int             rows;
+
+    SlicedImage(void) : rows(0)
+    {
+        memset(Bits, 0, sizeof(Bits));
+    }
+
+    // from a byte image, raw[rows][TOOL_MAX_DUT]
+    void Load(const byte* raw, int rows_in)
+    {
+        rows = (rows_in < SLICE_MAX_ROWS) ? rows_in : SLICE_MAX_ROWS;
+
+        for (int i = 0; i < rows; i++)
+            SliceRow(&raw[i * TOOL_MAX_DUT], Bits[i]);
+    }
+
+    void Load(Image& img)
+    {
+        Load(&img.Raw[0][0], NUM_RAM_REG);
+    }
+
+    // back to a byte image, raw[rows][TOOL_MAX_DUT]
+    void Store(byte* raw)
+    {
+        for (int i = 0; i < rows; i++)
+            UnsliceRow(Bits[i], &raw[i * TOOL_MAX_DUT]);
+    }
+
+    // DUT lanes of one register bit
+    qword* Lanes(int reg, int bit) { return Bits[reg][bit]; }
+
+    // DUTs in active with the bit set
+    void Flag(int reg, int bit, DutLanes& active, DutLanes& flags)
+    {
+        for (int l = 0; l < SLICE_LANES; l++)
+            flags.lane[l] = Bits[reg][bit][l] & active.lane[l];
+    }
+
+    // DUTs in active with any bit of mask set
+    void FlagAny(int reg, byte mask, DutLanes& active, DutLanes& flags)
+    {
+        flags.Clear();
+
+        for (; mask != 0; mask &= (byte)(mask - 1))
+        {
+            int b = CUtilities::CountTrailingZeros(mask);
+            for (int l = 0; l < SLICE_LANES; l++)
+                flags.lane[l] |= Bits[reg][b][l] & active.lane[l];
+        }
+    }
+
+    // masked compare against a Default: fail gets the DUTs in active with
+    // any masked bit different from the spec.  difference (optional) gets
+    // what Default::CompareMasked puts in its diff: every bit that differs
+    // from the spec, on the rows a DUT fails.
+    void CompareMasked(Default& spec, DutLanes& active, DutLanes& fail, SlicedImage* difference = NULL)
+    {
+        int count = (rows < NUM_RAM_REG) ? rows : NUM_RAM_REG;
+        qword row[SLICE_LANES];
+
+        fail.Clear();
+
+        if (difference != NULL)
+        {
+            memset(difference->Bits, 0, count * sizeof(Bits[0]));
+            difference->rows = count;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            memset(row, 0, sizeof(row));
+
+            for (byte mask = spec.Mask[i]; mask != 0; mask &= (byte)(mask - 1))
+            {
+                int b = CUtilities::CountTrailingZeros(mask);
+                qword want = ((spec.SpecImage[i] >> b) & 1) ? ~(qword)0 : 0;
+
+                for (int l = 0; l < SLICE_LANES; l++)
+                    row[l] |= (Bits[i][b][l] ^ want) & active.lane[l];
+            }
+
+            for (int l = 0; l < SLICE_LANES; l++)
+                fail.lane[l] |= row[l];
+
+            if (difference == NULL)
+                continue;
+
+            for (int b = 0; b < 8; b++)
+            {
+                qword want = ((spec.SpecImage[i] >> b) & 1) ? ~(qword)0 : 0;
+
+                for (int l = 0; l < SLICE_LANES; l++)
+                    difference->Bits[i][b][l] = (Bits[i][b][l] ^ want) & row[l];
+            }
+        }
+    }
+
+    // same results as Default::CompareMasked
+    void CompareMasked(Default& spec, bool* result, word* listDut)
+    {
+        DutLanes active, fail;
+
+        active.Set(listDut);
+        CompareMasked(spec, active, fail);
+        fail.ToResult(result);
+    }
+
+    // adds, per register bit, the DUTs in active that have it set
+    // (counts[rows][8]); on a difference image these are fail counts
+    void CountBits(dword (*counts)[8], DutLanes& active)
+    {
+        for (int i = 0; i < rows; i++)
+        {
+            for (int b = 0; b < 8; b++)
+            {
+                for (int l = 0; l < SLICE_LANES; l++)
+                    counts[i][b] += CUtilities::PopCount(Bits[i][b][l] & active.lane[l]);
+            }
+        }
+    }
+} SlicedImage;
+
+#endif
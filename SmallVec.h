@@ -0,0 +1,239 @@
+/******************************************************************************
+
+    File:   SmallVec.h
+    Desc:   Fixed capacity lists stored inline, for the DUT lists and other
+            short lists that are built and searched every test step.  Both
+            keep their length, so appending is O(1), capacity is checked, and
+            a 0 value can be stored.  Data() is still zero terminated and can
+            be passed wherever a listDut is expected (as long as the list has
+            no 0 values).
+
+            SmallVec keeps insertion order and searches linearly, 8 words or
+            4 ints per compare with SSE2.  SmallSet keeps its values sorted
+            and unique and searches with a binary search.
+
+******************************************************************************/
+#ifndef _SMALL_VEC_H_
+#define _SMALL_VEC_H_
+
+#include <algorithm>
+
+#include "Defines.h"
+#include "Utilities.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SMALLVEC_SSE2
+#endif
+
+//-----------------------------------------------------------------------------
+//  linear search, returns the index of value or -1
+template <typename T>
+inline int SmallFind(const T* data, int count, T value)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (data[i] == value)
+            return i;
+    }
+    return -1;
+}
+
+inline int SmallFind(const word* data, int count, word value)
+{
+    int i = 0;
+#ifdef SMALLVEC_SSE2
+    const __m128i key = _mm_set1_epi16((short)value);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)&data[i]);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(block, key));
+        if (mask != 0)
+            return i + (CUtilities::CountTrailingZeros(mask) >> 1);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (data[i] == value)
+            return i;
+    }
+    return -1;
+}
+
+inline int SmallFind(const int* data, int count, int value)
+{
+    int i = 0;
+#ifdef SMALLVEC_SSE2
+    const __m128i key = _mm_set1_epi32(value);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)&data[i]);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(block, key));
+        if (mask != 0)
+            return i + (CUtilities::CountTrailingZeros(mask) >> 2);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        if (data[i] == value)
+            return i;
+    }
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+//  SmallVec class
+template <typename T, int N>
+class SmallVec
+{
+private:
+    T Items[N + 1];                     // one extra for the terminating 0
+    int Count;
+
+public:
+    SmallVec(void) : Count(0) { Items[0] = 0; }
+    explicit SmallVec(const T* list) : Count(0) { Items[0] = 0; Assign(list); }
+
+    int Size(void) const { return Count; }
+    static int Capacity(void) { return N; }
+    bool Empty(void) const { return (Count == 0); }
+    bool Full(void) const { return (Count == N); }
+
+    T& operator[](int i) { return Items[i]; }
+    const T& operator[](int i) const { return Items[i]; }
+    T* begin(void) { return Items; }
+    T* end(void) { return Items + Count; }
+    const T* begin(void) const { return Items; }
+    const T* end(void) const { return Items + Count; }
+
+    // zero terminated, for code that takes a listDut
+    T* Data(void) { return Items; }
+    const T* Data(void) const { return Items; }
+
+    void Clear(void)
+    {
+        Count = 0;
+        Items[0] = 0;
+    }
+
+    // returns false when full
+    bool Push(T value)
+    {
+        if (Count >= N)
+            return false;
+
+        Items[Count++] = value;
+        Items[Count] = 0;
+        return true;
+    }
+
+    void Pop(void)
+    {
+        if (Count > 0)
+            Items[--Count] = 0;
+    }
+
+    // copies a zero terminated list, returns false if it did not fit
+    bool Assign(const T* list)
+    {
+        Clear();
+        for (int i = 0; list[i] != 0; i++)
+        {
+            if (!Push(list[i]))
+                return false;
+        }
+        return true;
+    }
+
+    int Find(T value) const { return SmallFind(Items, Count, value); }
+    bool Contains(T value) const { return (Find(value) >= 0); }
+
+    // drops the values pred returns true for, keeping the order of the rest
+    template <typename F>
+    int RemoveIf(F pred)
+    {
+        int kept = 0;
+
+        for (int i = 0; i < Count; i++)
+        {
+            if (!pred(Items[i]))
+                Items[kept++] = Items[i];
+        }
+
+        int removed = Count - kept;
+        Count = kept;
+        Items[Count] = 0;
+        return removed;
+    }
+};
+
+//-----------------------------------------------------------------------------
+//  SmallSet class
+template <typename T, int N>
+class SmallSet
+{
+private:
+    T Items[N + 1];                     // sorted, one extra for the terminating 0
+    int Count;
+
+    int LowerBound(T value) const
+    {
+        return (int)(std::lower_bound(Items, Items + Count, value) - Items);
+    }
+
+public:
+    SmallSet(void) : Count(0) { Items[0] = 0; }
+
+    int Size(void) const { return Count; }
+    static int Capacity(void) { return N; }
+    bool Empty(void) const { return (Count == 0); }
+
+    const T& operator[](int i) const { return Items[i]; }
+    const T* begin(void) const { return Items; }
+    const T* end(void) const { return Items + Count; }
+    const T* Data(void) const { return Items; }
+
+    void Clear(void)
+    {
+        Count = 0;
+        Items[0] = 0;
+    }
+
+    // returns false when full, true if value is (now) in the set
+    bool Insert(T value)
+    {
+        int pos = LowerBound(value);
+
+        if ((pos < Count) && (Items[pos] == value))
+            return true;
+        if (Count >= N)
+            return false;
+
+        memmove(&Items[pos + 1], &Items[pos], (Count - pos) * sizeof(T));
+        Items[pos] = value;
+        Items[++Count] = 0;
+        return true;
+    }
+
+    bool Remove(T value)
+    {
+        int pos = Find(value);
+
+        if (pos < 0)
+            return false;
+
+        memmove(&Items[pos], &Items[pos + 1], (Count - pos - 1) * sizeof(T));
+        Items[--Count] = 0;
+        return true;
+    }
+
+    int Find(T value) const
+    {
+        int pos = LowerBound(value);
+        return ((pos < Count) && (Items[pos] == value)) ? pos : -1;
+    }
+
+    bool Contains(T value) const { return (Find(value) >= 0); }
+};
+
+#endif
@@ -0,0 +1,561 @@
+/******************************************************************************
+
+    File:   SpecBundle.cpp
+    Desc:   Precompiled spec bundles: the offline writer and the
+            memory-mapped loader.
+
+******************************************************************************/
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Utilities.h"
+#include "SpecBundle.h"
+
+#define BUNDLE_PAD(n)           (((n) + BUNDLE_ALIGN - 1) & ~(BUNDLE_ALIGN - 1))
+
+static int CompareEntry(const BundleEntry& e, dword kind, const char* name)
+{
+    if (e.kind != kind)
+        return (e.kind < kind) ? -1 : 1;
+
+    return strncmp(e.name, name, BUNDLE_NAME_SIZE);
+}
+
+static bool EntryLess(const BundleEntry& a, const BundleEntry& b)
+{
+    return CompareEntry(a, b.kind, b.name) < 0;
+}
+
+/******************************************************************************
+    Name:   SpecBundle
+    Desc:   Default constructor
+******************************************************************************/
+SpecBundle::SpecBundle(void)
+{
+    this->Base = NULL;
+    this->Size = 0;
+    this->Header = NULL;
+    this->Directory = NULL;
+    this->FileHandle = NULL;
+    this->MapHandle = NULL;
+}
+
+/******************************************************************************
+    Name:   ~SpecBundle
+    Desc:   Default destructor, unmaps the bundle
+******************************************************************************/
+SpecBundle::~SpecBundle(void)
+{
+    this->Close();
+}
+
+/******************************************************************************
+    Name:   Open
+    Desc:   Maps a bundle copy-on-write and validates it.  Nothing is parsed
+            or copied; pointers returned by GetSpec and GetMap stay valid
+            until Close.
+******************************************************************************/
+int SpecBundle::Open(char* filename)
+{
+    DBGTrace("---> SpecBundle::Open");
+
+    String msg;
+
+    this->Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        this->FileHandle = file;
+        this->Size = GetFileSize(file, NULL);
+
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (map != NULL)
+        {
+            this->MapHandle = map;
+            this->Base = (byte*)MapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+        }
+    }
+#else
+    int file = open(filename, O_RDONLY);
+
+    if (file >= 0)
+    {
+        struct stat info;
+
+        this->FileHandle = (void*)(intptr_t)(file + 1);
+        if ((fstat(file, &info) == 0) && (info.st_size > 0))
+        {
+            this->Size = (dword)info.st_size;
+
+            void* base = mmap(NULL, this->Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+            if (base != MAP_FAILED)
+                this->Base = (byte*)base;
+        }
+    }
+#endif
+
+    if (this->Base == NULL)
+    {
+        sprintf(msg, "SpecBundle could not map %s", filename);
+        CUtilities::Error.Add(msg);
+        this->Close();
+        return ERROR_RUN;
+    }
+
+    int status = this->Validate(filename);
+    if (status != SUCCESS)
+    {
+        this->Close();
+        return status;
+    }
+
+    this->Header = (BundleHeader*)this->Base;
+    this->Directory = (BundleEntry*)(this->Base + sizeof(BundleHeader));
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Validate
+    Desc:   Checks the header, the checksum and every directory entry
+******************************************************************************/
+int SpecBundle::Validate(char* filename)
+{
+    String msg;
+    BundleHeader* header = (BundleHeader*)this->Base;
+    BundleEntry* directory = (BundleEntry*)(this->Base + sizeof(BundleHeader));
+
+    if ( (this->Size < sizeof(BundleHeader)) || (header->magic != BUNDLE_MAGIC) )
+        sprintf(msg, "SpecBundle: %s is not a spec bundle", filename);
+    else if (header->version != BUNDLE_VERSION)
+        sprintf(msg, "SpecBundle: %s is version %u, expected %u", filename, header->version, BUNDLE_VERSION);
+    else if ( (header->ramReg != NUM_RAM_REG) || (header->maxAddr != APP_MAX_ADDR) )
+        sprintf(msg, "SpecBundle: %s was built for %u registers and %u addresses", filename,
+            header->ramReg, header->maxAddr);
+    else if ( (header->size != this->Size) ||
+              (sizeof(BundleHeader) + (qword)header->entries * sizeof(BundleEntry) > this->Size) )
+        sprintf(msg, "SpecBundle: %s is truncated", filename);
+    else if (SpecBundle::Crc32(this->Base + sizeof(BundleHeader), this->Size - sizeof(BundleHeader)) != header->crc)
+        sprintf(msg, "SpecBundle: %s failed its checksum", filename);
+    else
+    {
+        for (dword i = 0; i < header->entries; i++)
+        {
+            BundleEntry& e = directory[i];
+            dword expected = (e.kind == BUNDLE_SPEC) ? sizeof(Default) : e.count * sizeof(BundleField);
+
+            if ( ((qword)e.offset + e.size > this->Size) || (e.size != expected) ||
+                 ((e.kind != BUNDLE_SPEC) && (e.kind != BUNDLE_MAP)) )
+            {
+                sprintf(msg, "SpecBundle: %s has a bad entry %.32s", filename, e.name);
+                ERRLog(ERROR_INIT, msg);
+                return ERROR_INIT;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    ERRLog(ERROR_INIT, msg);
+    return ERROR_INIT;
+}
+
+/******************************************************************************
+    Name:   Close
+    Desc:   Unmaps the bundle
+******************************************************************************/
+void SpecBundle::Close(void)
+{
+#ifdef _WIN32
+    if (this->Base != NULL)
+        UnmapViewOfFile(this->Base);
+    if (this->MapHandle != NULL)
+        CloseHandle((HANDLE)this->MapHandle);
+    if (this->FileHandle != NULL)
+        CloseHandle((HANDLE)this->FileHandle);
+#else
+    if (this->Base != NULL)
+        munmap(this->Base, this->Size);
+    if (this->FileHandle != NULL)
+        close((int)(intptr_t)this->FileHandle - 1);
+#endif
+
+    this->Base = NULL;
+    this->Size = 0;
+    this->Header = NULL;
+    this->Directory = NULL;
+    this->FileHandle = NULL;
+    this->MapHandle = NULL;
+}
+
+/******************************************************************************
+    Name:   Find
+    Desc:   Binary search of the directory
+******************************************************************************/
+BundleEntry* SpecBundle::Find(dword kind, const char* name)
+{
+    if (!this->IsOpen())
+        return NULL;
+
+    int lo = 0;
+    int hi = (int)this->Header->entries - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = CompareEntry(this->Directory[mid], kind, name);
+
+        if (cmp == 0)
+            return &this->Directory[mid];
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+    Name:   GetSpec
+    Desc:   Default image stored in the bundle, or NULL
+******************************************************************************/
+Default* SpecBundle::GetSpec(const char* name)
+{
+    BundleEntry* e = this->Find(BUNDLE_SPEC, name);
+
+    if (e == NULL)
+    {
+        String msg;
+        sprintf(msg, "SpecBundle has no spec %s", name);
+        ERRLog(ERROR_SPEC, msg);
+        return NULL;
+    }
+
+    return (Default*)(this->Base + e->offset);
+}
+
+/******************************************************************************
+    Name:   GetMap
+    Desc:   Register map fields stored in the bundle, or NULL
+******************************************************************************/
+BundleField* SpecBundle::GetMap(const char* name, int* count)
+{
+    BundleEntry* e = this->Find(BUNDLE_MAP, name);
+
+    if (e == NULL)
+    {
+        String msg;
+        sprintf(msg, "SpecBundle has no register map %s", name);
+        ERRLog(ERROR_SPEC, msg);
+        *count = 0;
+        return NULL;
+    }
+
+    *count = (int)e->count;
+    return (BundleField*)(this->Base + e->offset);
+}
+
+/******************************************************************************
+    Name:   MapToRAMstruct
+    Desc:   Fills a RAMstruct from a map in the bundle, for code that still
+            takes one
+******************************************************************************/
+int SpecBundle::MapToRAMstruct(const char* name, RAMstruct& RAMregisters)
+{
+    int count;
+    BundleField* fields = this->GetMap(name, &count);
+
+    if (fields == NULL)
+        return ERROR_SPEC;
+
+    for (int i = 0; i < count; i++)
+    {
+        String label;
+        strncpy(label, fields[i].name, BUNDLE_NAME_SIZE);
+        label[BUNDLE_NAME_SIZE - 1] = '\0';
+
+        ASICregister reg(label, fields[i].page, fields[i].addr, fields[i].mask,
+            convert_type((contype)fields[i].conversion), memory_type((mtype)fields[i].memory), fields[i].num);
+        RAMregisters.Add(reg);
+    }
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Crc32
+    Desc:   CRC-32 (IEEE 802.3), pass the previous result to continue
+******************************************************************************/
+dword SpecBundle::Crc32(const byte* data, dword size, dword crc)
+{
+    static dword table[256];
+    static bool ready = false;
+
+    if (!ready)
+    {
+        for (dword n = 0; n < 256; n++)
+        {
+            dword c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            table[n] = c;
+        }
+        ready = true;
+    }
+
+    crc = ~crc;
+    for (dword i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+/******************************************************************************
+    Name:   SpecBundleWriter
+    Desc:   Default constructor
+******************************************************************************/
+SpecBundleWriter::SpecBundleWriter(void)
+{
+}
+
+/******************************************************************************
+    Name:   ~SpecBundleWriter
+    Desc:   Default destructor
+******************************************************************************/
+SpecBundleWriter::~SpecBundleWriter(void)
+{
+}
+
+/******************************************************************************
+    Name:   Add
+    Desc:   Queues a payload for Write
+******************************************************************************/
+int SpecBundleWriter::Add(dword kind, const char* name, const void* data, dword size, dword count)
+{
+    String msg;
+    BundleEntry e;
+
+    if (strlen(name) >= BUNDLE_NAME_SIZE)
+    {
+        sprintf(msg, "SpecBundleWriter: name %s is longer than %i characters", name, BUNDLE_NAME_SIZE - 1);
+        ERRLog(ERROR_SPEC, msg);
+        return ERROR_SPEC;
+    }
+
+    for (size_t i = 0; i < this->Entries.size(); i++)
+    {
+        if (CompareEntry(this->Entries[i], kind, name) == 0)
+        {
+            sprintf(msg, "SpecBundleWriter: %s was added twice", name);
+            ERRLog(ERROR_SPEC, msg);
+            return ERROR_SPEC;
+        }
+    }
+
+    memset(&e, 0, sizeof(e));
+    strcpy(e.name, name);
+    e.kind = kind;
+    e.size = size;
+    e.count = count;
+    e.offset = (dword)this->Payloads.size();    // payload index until Write
+
+    const byte* bytes = (const byte*)data;
+    this->Payloads.push_back(vector<byte>(bytes, bytes + size));
+    this->Entries.push_back(e);
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   AddSpec
+    Desc:   Adds a spec image and mask
+******************************************************************************/
+int SpecBundleWriter::AddSpec(const char* name, Default& spec)
+{
+    return this->Add(BUNDLE_SPEC, name, &spec, sizeof(Default), 1);
+}
+
+int SpecBundleWriter::AddSpec(const char* name, char* default_in, char* mask_in)
+{
+    Default spec(default_in, mask_in);
+    return this->AddSpec(name, spec);
+}
+
+/******************************************************************************
+    Name:   AddMap
+    Desc:   Adds a register map, from a RegisterMap table or a RAMstruct
+******************************************************************************/
+int SpecBundleWriter::AddMap(const char* name, const RegField* t, int n)
+{
+    vector<BundleField> fields(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        BundleField& f = fields[i];
+
+        memset(&f, 0, sizeof(f));
+        strncpy(f.name, t[i].name, BUNDLE_NAME_SIZE - 1);
+        f.page = t[i].page;
+        f.num = (byte)t[i].num;
+        f.conversion = (byte)t[i].conversion;
+        f.memory = (byte)t[i].memory;
+        memcpy(f.addr, t[i].addr, sizeof(f.addr));
+        memcpy(f.mask, t[i].mask, sizeof(f.mask));
+    }
+
+    return this->Add(BUNDLE_MAP, name, n ? &fields[0] : NULL, n * sizeof(BundleField), n);
+}
+
+int SpecBundleWriter::AddMap(const char* name, RAMstruct& RAMregisters)
+{
+    int n = (int)RAMregisters.RAMvector.size();
+    vector<BundleField> fields(n);
+
+    for (int i = 0; i < n; i++)
+    {
+        ASICregister& reg = RAMregisters.RAMvector[i];
+        BundleField& f = fields[i];
+
+        memset(&f, 0, sizeof(f));
+        strncpy(f.name, reg.name, BUNDLE_NAME_SIZE - 1);
+        f.page = reg.page;
+        f.num = (byte)reg.num_registers;
+        f.conversion = (byte)reg.conversion.type;
+        f.memory = (byte)reg.memory.type;
+        memcpy(f.addr, reg.addr, sizeof(f.addr));
+        memcpy(f.mask, reg.mask, sizeof(f.mask));
+    }
+
+    return this->Add(BUNDLE_MAP, name, n ? &fields[0] : NULL, n * sizeof(BundleField), n);
+}
+
+/******************************************************************************
+    Name:   Compile
+    Desc:   Adds the specs listed in a text file, one per line as
+            name|default|mask with the same hex strings the Spec files use.
+            Empty lines and lines starting with # are skipped.
+******************************************************************************/
+int SpecBundleWriter::Compile(char* filename)
+{
+    DBGTrace("---> SpecBundleWriter::Compile");
+
+    String msg;
+    char line[APP_MAX_CHAR_LONGER];
+    int number = 0;
+    int status = SUCCESS;
+
+    FILE* file = fopen(filename, "r");
+
+    if (file == NULL)
+    {
+        sprintf(msg, "SpecBundleWriter could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if ( (line[0] == '\0') || (line[0] == '#') )
+            continue;
+
+        char* name = line;
+        char* spec = strchr(name, '|');
+        char* mask = (spec != NULL) ? strchr(spec + 1, '|') : NULL;
+
+        if (mask == NULL)
+        {
+            sprintf(msg, "SpecBundleWriter: %s line %i is not name|default|mask", filename, number);
+            ERRLog(ERROR_SPEC, msg);
+            status = ERROR_SPEC;
+            continue;
+        }
+
+        *spec++ = '\0';
+        *mask++ = '\0';
+
+        if (this->AddSpec(name, spec, mask) != SUCCESS)
+            status = ERROR_SPEC;
+    }
+
+    fclose(file);
+
+    return status;
+}
+
+/******************************************************************************
+    Name:   Write
+    Desc:   Writes the bundle, directory sorted for the loader's binary search
+******************************************************************************/
+int SpecBundleWriter::Write(char* filename)
+{
+    DBGTrace("---> SpecBundleWriter::Write");
+
+    vector<BundleEntry> directory(this->Entries);
+    std::sort(directory.begin(), directory.end(), EntryLess);
+
+    // lay out the payloads after the directory
+    dword offset = BUNDLE_PAD(sizeof(BundleHeader) + directory.size() * sizeof(BundleEntry));
+    vector<dword> index(directory.size());
+
+    for (size_t i = 0; i < directory.size(); i++)
+    {
+        index[i] = directory[i].offset;
+        directory[i].offset = offset;
+        offset = BUNDLE_PAD(offset + directory[i].size);
+    }
+
+    vector<byte> data(offset, 0);
+    BundleHeader header;
+
+    if (!directory.empty())
+        memcpy(&data[sizeof(BundleHeader)], &directory[0], directory.size() * sizeof(BundleEntry));
+
+    for (size_t i = 0; i < directory.size(); i++)
+    {
+        vector<byte>& payload = this->Payloads[index[i]];
+        if (!payload.empty())
+            memcpy(&data[directory[i].offset], &payload[0], payload.size());
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = BUNDLE_MAGIC;
+    header.version = BUNDLE_VERSION;
+    header.ramReg = NUM_RAM_REG;
+    header.maxAddr = APP_MAX_ADDR;
+    header.entries = (dword)directory.size();
+    header.size = offset;
+    header.crc = SpecBundle::Crc32(&data[sizeof(BundleHeader)], offset - sizeof(BundleHeader));
+    memcpy(&data[0], &header, sizeof(header));
+
+    FILE* file = fopen(filename, "wb");
+
+    if (file == NULL)
+    {
+        String msg;
+        sprintf(msg, "SpecBundleWriter could not open %s", filename);
+        CUtilities::Error.Add(msg);
+        return ERROR_RUN;
+    }
+
+    size_t written = fwrite(&data[0], 1, data.size(), file);
+    fclose(file);
+
+    return (written == data.size()) ? SUCCESS : ERROR_RUN;
+}
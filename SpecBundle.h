@@ -0,0 +1,134 @@
+/******************************************************************************
+
+    File:   SpecBundle.h
+    Desc:   Precompiled spec bundles.  SpecBundleWriter runs offline and
+            turns spec images, masks and register maps into one versioned
+            binary file; SpecBundle memory-maps that file at program load and
+            hands out Default images that point straight into the mapping,
+            so a product changeover does no hex parsing and no copying.
+
+            The file is a BundleHeader, a directory of BundleEntry sorted by
+            kind and name, then the payloads (8 byte aligned).  A spec payload
+            is a Default as it is laid out in memory, a map payload is an
+            array of BundleField.  The header holds a CRC-32 of everything
+            after it, and the NUM_RAM_REG and APP_MAX_ADDR the bundle was
+            built with, so a stale bundle is refused instead of misread.
+
+            The mapping is copy-on-write: Default's member functions are not
+            const, and a stray write changes only this process's copy.
+
+******************************************************************************/
+#ifndef _SPEC_BUNDLE_H_
+#define _SPEC_BUNDLE_H_
+
+#include <vector>
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+#include "RegisterMap.h"
+
+#define BUNDLE_MAGIC            0x31425053      // "SPB1"
+#define BUNDLE_VERSION          1
+#define BUNDLE_NAME_SIZE        32
+#define BUNDLE_ALIGN            8
+
+#define BUNDLE_SPEC             1
+#define BUNDLE_MAP              2
+
+// spec payloads are served in place, so Default must stay plain data
+static_assert(sizeof(Default) == 2 * NUM_RAM_REG, "Default is no longer SpecImage + Mask");
+
+//-----------------------------------------------------------------------------
+//  file layout
+typedef struct BundleHeader
+{
+    dword           magic;
+    dword           version;
+    dword           ramReg;             // NUM_RAM_REG at compile time
+    dword           maxAddr;            // APP_MAX_ADDR at compile time
+    dword           entries;
+    dword           size;               // whole file
+    dword           crc;                // CRC-32 of everything after the header
+    dword           reserved;
+} BundleHeader;
+
+typedef struct BundleEntry
+{
+    char            name[BUNDLE_NAME_SIZE];
+    dword           kind;               // BUNDLE_SPEC or BUNDLE_MAP
+    dword           offset;             // from the start of the file
+    dword           size;
+    dword           count;              // fields in a map, 1 for a spec
+} BundleEntry;
+
+typedef struct BundleField
+{
+    char            name[BUNDLE_NAME_SIZE];
+    byte            page;
+    byte            num;
+    byte            conversion;         // contype
+    byte            memory;             // mtype
+    byte            addr[APP_MAX_ADDR];
+    byte            mask[APP_MAX_ADDR];
+} BundleField;
+
+//-----------------------------------------------------------------------------
+//  SpecBundle class definition (loader)
+class SpecBundle
+{
+private:
+    byte* Base;
+    dword Size;
+    BundleHeader* Header;
+    BundleEntry* Directory;
+    void* FileHandle;
+    void* MapHandle;
+
+    SpecBundle(const SpecBundle&);
+    SpecBundle& operator=(const SpecBundle&);
+
+    BundleEntry* Find(dword kind, const char* name);
+    int Validate(char* filename);
+
+public:
+    SpecBundle(void);
+    ~SpecBundle(void);
+
+    int Open(char* filename);
+    void Close(void);
+    bool IsOpen(void) { return (this->Base != NULL); }
+
+    int GetCount(void) { return this->IsOpen() ? (int)this->Header->entries : 0; }
+    BundleEntry* GetEntry(int index) { return &this->Directory[index]; }
+
+    Default* GetSpec(const char* name);
+    BundleField* GetMap(const char* name, int* count);
+    int MapToRAMstruct(const char* name, RAMstruct& RAMregisters);
+
+    static dword Crc32(const byte* data, dword size, dword crc = 0);
+};
+
+//-----------------------------------------------------------------------------
+//  SpecBundleWriter class definition (offline compiler)
+class SpecBundleWriter
+{
+private:
+    vector<BundleEntry> Entries;
+    vector< vector<byte> > Payloads;
+
+    int Add(dword kind, const char* name, const void* data, dword size, dword count);
+
+public:
+    SpecBundleWriter(void);
+    ~SpecBundleWriter(void);
+
+    int AddSpec(const char* name, Default& spec);
+    int AddSpec(const char* name, char* default_in, char* mask_in);
+    int AddMap(const char* name, const RegField* t, int n);
+    int AddMap(const char* name, RAMstruct& RAMregisters);
+
+    int Compile(char* filename);
+    int Write(char* filename);
+};
+
+#endif
@@ -0,0 +1,152 @@
+/******************************************************************************
+
+    File:   SpecSet.h
+    Desc:   Compares an image against several Default spec/mask pairs at
+            once, for products with more than one variant.  Each DUT gets a
+            masked mismatch count per spec plus its first and best matching
+            spec, from a single pass over Raw.
+
+******************************************************************************/
+#ifndef _SPEC_SET_H_
+#define _SPEC_SET_H_
+
+#include "Defines.h"
+#include "RegisterTypeDefs.h"
+
+#ifndef SPECSET_MAX_SPECS
+#define SPECSET_MAX_SPECS       8
+#endif
+
+#define SPEC_NO_MATCH           -1
+
+//-----------------------------------------------------------------------------
+//  SpecSet struct
+typedef struct SpecSet
+{
+    byte            SpecImage[SPECSET_MAX_SPECS][NUM_RAM_REG];
+    byte            Mask[SPECSET_MAX_SPECS][NUM_RAM_REG];
+    int             count;
+
+    // results of the last Match, per spec and per DUT
+    word            Mismatch[SPECSET_MAX_SPECS][TOOL_MAX_DUT];  // masked bytes that differ
+    int             First[TOOL_MAX_DUT];    // first spec with no mismatch
+    int             Best[TOOL_MAX_DUT];     // spec with fewest mismatches
+
+    SpecSet(void) : count(0) {}
+
+    // add a spec, returns its index or SPEC_NO_MATCH when full
+    int Add(Default& spec)
+    {
+        if (count >= SPECSET_MAX_SPECS)
+        {
+            ERRLog(ERROR_SPEC, "SpecSet already holds SPECSET_MAX_SPECS specs.");
+            return SPEC_NO_MATCH;
+        }
+
+        memcpy(SpecImage[count], spec.SpecImage, sizeof(SpecImage[count]));
+        memcpy(Mask[count], spec.Mask, sizeof(Mask[count]));
+        return count++;
+    }
+
+    void Clear(void) { count = 0; }
+
+    // one pass over Raw[NUM_RAM_REG][TOOL_MAX_DUT].  The inner loops run over
+    // contiguous DUT lanes with no branches, so the compiler can vectorize
+    // them; DUTs not in listDut are compared too and ignored afterwards.
+    void Match(byte* Raw, word* listDut)
+    {
+        int dut;
+        byte active[TOOL_MAX_DUT];
+
+        memset(Mismatch, 0, sizeof(Mismatch));
+        memset(active, 0, sizeof(active));
+
+        for (int d = 0; listDut[d] != 0; d++)
+            active[listDut[d] - 1] = 1;
+
+        for (int i = 0; i < NUM_RAM_REG; i++)
+        {
+            const byte* row = &Raw[i * TOOL_MAX_DUT];
+
+            for (int k = 0; k < count; k++)
+            {
+                const byte spec = (byte)(SpecImage[k][i] & Mask[k][i]);
+                const byte mask = Mask[k][i];
+                word* mismatch = Mismatch[k];
+
+                if (mask == 0)
+                    continue;
+
+                for (int n = 0; n < TOOL_MAX_DUT; n++)
+                    mismatch[n] += (word)(((row[n] & mask) != spec) & active[n]);
+            }
+        }
+
+        for (int i = 0; i < TOOL_MAX_DUT; i++)
+        {
+            First[i] = SPEC_NO_MATCH;
+            Best[i] = SPEC_NO_MATCH;
+        }
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+
+            for (int k = 0; k < count; k++)
+            {
+                if ((Mismatch[k][dut] == 0) && (First[dut] == SPEC_NO_MATCH))
+                    First[dut] = k;
+                if ((Best[dut] == SPEC_NO_MATCH) || (Mismatch[k][dut] < Mismatch[Best[dut]][dut]))
+                    Best[dut] = k;
+            }
+        }
+    }
+
+    void Match(Image& img, word* listDut)
+    {
+        Match(&img.Raw[0][0], listDut);
+    }
+
+    // result per DUT against one spec, like Default::CompareMasked
+    void Result(int spec, bool* result, word* listDut)
+    {
+        int dut;
+
+        for (int i = 0; i < TOOL_MAX_DUT; i++)
+            result[i] = true;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            result[dut] = (Mismatch[spec][dut] == 0);
+        }
+    }
+
+    void Print(word* listDut)
+    {
+        int dut;
+        String msg, temp;
+
+        // always display
+        bool was_on = DBGVerboseEnabled;
+        DBGVerboseEnabled = YES;
+
+        for (int d = 0; listDut[d] != 0; d++)
+        {
+            dut = listDut[d] - 1;
+            sprintf(msg, "\nSpecSet [%i]: first %i best %i mismatches", dut, First[dut], Best[dut]);
+
+            for (int k = 0; k < count; k++)
+            {
+                sprintf(temp, " %i", Mismatch[k][dut]);
+                strcat(msg, temp);
+            }
+
+            DBGVerbose(msg);
+        }
+
+        DBGVerboseEnabled = was_on;
+    }
+} SpecSet;
+
+#endif
@@ -186,6 +186,7 @@ void CUtilities::ToString(void* value, variable_type type, char* formatIn, char*
                 if (strcmp(formatIn,"") == 0)
                     strcpy(format, "%3i");
                 sprintf(output, (char *)format, *((int*) value));
+                break;
             }
         case uint_type:
             {
@@ -506,44 +507,34 @@ void CUtilities::CopyArrayToDouble(void* input, variable_type type, int* sizeIn,
 
 /******************************************************************************
     Name:   BreakOutPowersOf2
-    Desc:   Take a double and break out all the powers of two and return a string
+    Desc:   Break out the set bits of a value as powers of two in a string,
+            lowest first when dir is 0 and highest first otherwise.  Use
+            BitDecoder to get named flags per DUT instead of a string.
 ******************************************************************************/
 void CUtilities::BreakOutPowersOf2(dword value, char* output, int dir)
 {
     DBGTrace("---> CUtilities::BreakOutPowersOf2");
     
-    String piece;
-    sprintf(output, "");
+    int bits[32];
+    int count = 0;
     
-    if (dir == 0)
-    {
-        for (int i = 0; i <= 32; i++)
-        {
-            if ((value & (1<<i)) != 0)
-            {
-                sprintf(piece, "%i ", 1<<i);
-                strcat(output, (char *)piece);
-            }
-        
-        }
-    }
-    else
+    output[0] = '\0';
+    
+    // only visit the set bits
+    for (dword rest = value; rest != 0; rest &= rest - 1)
+        bits[count++] = CUtilities::CountTrailingZeros(rest);
+    
+    for (int i = 0; i < count; i++)
     {
-        for (int i = 31; i > 0; i--)
-        {
-            if ((value & (1<<i)) != 0)
-            {
-                sprintf(piece, "%i ", 1<<i);
-                strcat(output, (char *)piece);
-            }
-        
-        }
+        int bit = (dir == 0) ? bits[i] : bits[count - 1 - i];
+        output += sprintf(output, "%u ", (dword)1 << bit);
     }
 }
 
 /******************************************************************************
     Name:   ConcatenateArray
     Desc:   Concatenate 2 zeros terminated arrays and return result in variable array_in
+            (no capacity check; lists built every step should use SmallVec)
 ******************************************************************************/
 void CUtilities::ConcatenateArray(int* array_in, int* array_to_add)
 {
@@ -561,6 +552,7 @@ void CUtilities::ConcatenateArray(int* array_in, int* array_to_add)
 /******************************************************************************
     Name:   FindInArray
     Desc:   Find value in zero terminated array
+            (rescans from the start; SmallVec/SmallSet keep their length)
 ******************************************************************************/
 int CUtilities::FindInArray(int value, int* array_in)
 {
@@ -579,7 +571,9 @@ int CUtilities::FindInArray(int value, int* array_in)
 
 /******************************************************************************
     Name:   FormatString
-    Desc:   
+    Desc:   Builds a label for every index and label in labels_in (which ends
+            with an empty string).  RecordSchema::AddColumns builds columns
+            in the same order.
 ******************************************************************************/
 int CUtilities::FormatString(String* labels_in, String labelFormat, int count, String* output, String* indicies)
 {
@@ -590,7 +584,7 @@ int CUtilities::FormatString(String* labels_in, String labelFormat, int count, S
     sprintf(*output,"");
     for (int i = 0; i < count; i++)
     {
-        for (int j = 0; strcmp(labels_in[j],"") == 1; j++)
+        for (int j = 0; labels_in[j][0] != '\0'; j++)
         {
             if (indicies != NULL)
             {
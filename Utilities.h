@@ -10,6 +10,10 @@
 
 #include "Defines.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define CONVERT_FROM_DOUBLE_DISABLED    0
 #define CONVERT_FROM_DOUBLE_ENABLED     1
 
@@ -39,6 +43,29 @@ public:
     static bool IsOdd(qword number) { return ( number%2 == 1 ); }
     static bool IsOdd(double number) { return ( ((int)floor(number))%2 == 1 ); }
     
+    static int PopCount(qword value)
+    {
+    #ifdef _MSC_VER
+        return (int)(__popcnt((unsigned int)value) + __popcnt((unsigned int)(value >> 32)));
+    #else
+        return __builtin_popcountll(value);
+    #endif
+    }
+    
+    // index of the lowest set bit, value must not be 0
+    static int CountTrailingZeros(qword value)
+    {
+    #ifdef _MSC_VER
+        unsigned long index;
+        if (_BitScanForward(&index, (unsigned long)value))
+            return (int)index;
+        _BitScanForward(&index, (unsigned long)(value >> 32));
+        return (int)index + 32;
+    #else
+        return __builtin_ctzll(value);
+    #endif
+    }
+    
     static String ByteToString(byte toConvert);
     static String ByteToString(byte* toConvert, int length);
     static void ByteToStringArray(String* output, byte* toConvert, int length, word* listDut);
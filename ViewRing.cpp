@@ -0,0 +1,336 @@
+/******************************************************************************
+
+    File:   ViewRing.cpp
+    Desc:   Shared-memory transport for the LabVIEW image viewer, see
+            ViewRing.h for the protocol.
+
+******************************************************************************/
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Utilities.h"
+#include "ViewRing.h"
+
+ViewRing* ViewRing::Publisher = NULL;
+
+/******************************************************************************
+    Name:   ViewRing
+    Desc:   Default constructor
+******************************************************************************/
+ViewRing::ViewRing(void)
+{
+    this->Header = NULL;
+    this->Slots = NULL;
+    this->Memory = NULL;
+    this->Handle = NULL;
+    this->Size = 0;
+    this->Owner = false;
+    this->Stale = 0;
+}
+
+/******************************************************************************
+    Name:   ~ViewRing
+    Desc:   Default destructor, detaches from the shared memory
+******************************************************************************/
+ViewRing::~ViewRing(void)
+{
+    this->Close();
+}
+
+/******************************************************************************
+    Name:   Create
+    Desc:   Creates the shared memory block as the publisher
+******************************************************************************/
+int ViewRing::Create(char* name, dword slots)
+{
+    DBGTrace("---> ViewRing::Create");
+
+    if (slots == 0)
+        slots = VIEW_DEFAULT_SLOTS;
+
+    return this->Map(name, slots, true);
+}
+
+/******************************************************************************
+    Name:   Open
+    Desc:   Attaches to an existing block as a reader.  A block from a build
+            with another slot size, or too small for its slots, is rejected.
+******************************************************************************/
+int ViewRing::Open(char* name)
+{
+    DBGTrace("---> ViewRing::Open");
+
+    return this->Map(name, 0, false);
+}
+
+/******************************************************************************
+    Name:   Map
+    Desc:   Maps the named block, creating and initializing it if asked
+******************************************************************************/
+int ViewRing::Map(char* name, dword slots, bool create)
+{
+    String msg;
+
+    this->Close();
+    strcpy(this->Name, name);
+    this->Owner = create;
+    this->Size = create ? (dword)(sizeof(ViewHeader) + slots * sizeof(ViewSlot)) : 0;
+
+#ifdef _WIN32
+    HANDLE handle = create
+        ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, this->Size, name)
+        : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+
+    if (handle != NULL)
+    {
+        this->Handle = handle;
+        this->Memory = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    if (!create && (this->Memory != NULL) && (VirtualQuery(this->Memory, &info, sizeof(info)) != 0))
+        this->Size = (dword)info.RegionSize;
+#else
+    String shm;
+    sprintf(shm, "/%s", name);
+
+    int fd = create ? shm_open(shm, O_CREAT | O_RDWR, 0666) : shm_open(shm, O_RDWR, 0);
+
+    if (fd >= 0)
+    {
+        struct stat info;
+
+        if (create && (ftruncate(fd, this->Size) != 0))
+            this->Size = 0;
+        else if (!create && (fstat(fd, &info) == 0))
+            this->Size = (dword)info.st_size;
+
+        if (this->Size >= sizeof(ViewHeader))
+        {
+            void* memory = mmap(NULL, this->Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (memory != MAP_FAILED)
+                this->Memory = memory;
+        }
+        close(fd);
+    }
+#endif
+
+    if (this->Memory == NULL)
+    {
+        sprintf(msg, "ViewRing could not map %s", name);
+        CUtilities::Error.Add(msg);
+        this->Close();
+        return ERROR_RUN;
+    }
+
+    ViewHeader* header = (ViewHeader*)this->Memory;
+
+    if (create)
+    {
+        memset(this->Memory, 0, this->Size);
+        header->magic = VIEW_MAGIC;
+        header->slots = slots;
+        header->slotSize = sizeof(ViewSlot);
+    }
+    else if ((this->Size < sizeof(ViewHeader)) || (header->magic != VIEW_MAGIC) ||
+             (header->slotSize != sizeof(ViewSlot)) || (header->slots == 0) ||
+             (header->slots > (this->Size - sizeof(ViewHeader)) / sizeof(ViewSlot)))
+    {
+        sprintf(msg, "ViewRing: %s is not a view ring of this build, or is too small", name);
+        CUtilities::Error.Add(msg);
+        this->Close();
+        return ERROR_RUN;
+    }
+
+    this->Header = header;
+    this->Slots = (ViewSlot*)((byte*)this->Memory + sizeof(ViewHeader));
+
+    return SUCCESS;
+}
+
+/******************************************************************************
+    Name:   Close
+    Desc:   Detaches; the publisher also removes the block
+******************************************************************************/
+void ViewRing::Close(void)
+{
+    if (ViewRing::Publisher == this)
+        ViewRing::Publisher = NULL;
+
+#ifdef _WIN32
+    if (this->Memory != NULL)
+        UnmapViewOfFile(this->Memory);
+    if (this->Handle != NULL)
+        CloseHandle((HANDLE)this->Handle);
+#else
+    if (this->Memory != NULL)
+    {
+        munmap(this->Memory, this->Size);
+
+        if (this->Owner)
+        {
+            String shm;
+            sprintf(shm, "/%s", (char*)this->Name);
+            shm_unlink(shm);
+        }
+    }
+#endif
+
+    this->Header = NULL;
+    this->Slots = NULL;
+    this->Memory = NULL;
+    this->Handle = NULL;
+    this->Size = 0;
+    this->Owner = false;
+}
+
+/******************************************************************************
+    Name:   WriteSlot
+    Desc:   Fills a slot, the sequence number is odd while it is written
+******************************************************************************/
+void ViewRing::WriteSlot(ViewSlot& slot, byte page, int dut, const byte* raw, const byte* ref, int count, int stride)
+{
+    dword seq = slot.seq.load(std::memory_order_relaxed);
+
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    ViewFrame& frame = slot.frame;
+
+    frame.page = page;
+    frame.dut = (word)dut;
+    frame.length = (word)count;
+    frame.hasRef = (ref != NULL);
+    frame.sequence = this->Header->published.load(std::memory_order_relaxed);
+
+    for (int i = 0; i < count; i++)
+        frame.data[i] = raw[i * stride];
+
+    if (ref != NULL)
+    {
+        for (int i = 0; i < count; i++)
+            frame.ref[i] = ref[i * stride];
+    }
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+/******************************************************************************
+    Name:   Publish
+    Desc:   Publishes one frame without waiting for the viewer
+******************************************************************************/
+void ViewRing::Publish(byte page, int dut, const byte* raw, const byte* ref, int count, int stride)
+{
+    if (!this->IsOpen())
+        return;
+
+    ViewHeader& h = *this->Header;
+    const dword slots = h.slots;
+
+    if (count > VIEW_MAX_BYTES)
+        count = VIEW_MAX_BYTES;
+
+    h.published.fetch_add(1, std::memory_order_relaxed);
+
+    dword head = h.head.load(std::memory_order_relaxed);
+    dword tail = h.tail.load(std::memory_order_acquire);
+
+    // the viewer only needs the latest frame per (page, DUT)
+    for (dword s = tail; s != head; s++)
+    {
+        ViewSlot& slot = this->Slots[s % slots];
+
+        if ((slot.frame.page != page) || (slot.frame.dut != dut))
+            continue;
+
+        this->WriteSlot(slot, page, dut, raw, ref, count, stride);
+
+        // still unread afterwards, otherwise append it as a new frame
+        if ((dword)(h.tail.load(std::memory_order_acquire) - tail) <= (s - tail))
+        {
+            h.coalesced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    }
+
+    // full: drop the oldest unread frame
+    tail = h.tail.load(std::memory_order_acquire);
+    if ((head - tail >= slots) &&
+        h.tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+        h.dropped.fetch_add(1, std::memory_order_relaxed);
+
+    this->WriteSlot(this->Slots[head % slots], page, dut, raw, ref, count, stride);
+    h.head.store(head + 1, std::memory_order_release);
+}
+
+/******************************************************************************
+    Name:   Poll
+    Desc:   Reader side: copies out the oldest unread frame, false if none.
+            A slot that stays unreadable for VIEW_MAX_SPINS tries is skipped
+            and Poll returns false, so a publisher that died while writing
+            cannot hang the viewer.
+******************************************************************************/
+bool ViewRing::Poll(ViewFrame& frame)
+{
+    if (!this->IsOpen())
+        return false;
+
+    ViewHeader& h = *this->Header;
+    dword last = h.tail.load(std::memory_order_relaxed);
+    int spins = 0;
+
+    while (true)
+    {
+        dword tail = h.tail.load(std::memory_order_acquire);
+
+        if (tail == h.head.load(std::memory_order_acquire))
+            return false;
+
+        // tries on the same slot
+        spins = (tail == last) ? spins + 1 : 0;
+        last = tail;
+
+        ViewSlot& slot = this->Slots[tail % h.slots];
+        dword seq = slot.seq.load(std::memory_order_acquire);
+
+        if (spins > VIEW_MAX_SPINS)
+        {
+            if (h.tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+                this->Stale++;
+            return false;
+        }
+
+        if (seq & 1)
+            continue;
+
+        memcpy(&frame, &slot.frame, sizeof(ViewFrame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // rewritten while copying, or dropped by the publisher: read again
+        if (slot.seq.load(std::memory_order_relaxed) != seq)
+            continue;
+
+        if (h.tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel))
+            return true;
+    }
+}
+
+/******************************************************************************
+    Name:   GetPending
+    Desc:   Frames published and not read yet
+******************************************************************************/
+int ViewRing::GetPending(void)
+{
+    if (!this->IsOpen())
+        return 0;
+
+    return (int)(this->Header->head.load() - this->Header->tail.load());
+}
@@ -0,0 +1,119 @@
+/******************************************************************************
+
+    File:   ViewRing.h
+    Desc:   Shared-memory transport for the LabVIEW image viewer.  The test
+            program publishes raw image frames (page, DUT, bytes and the
+            reference bytes) into a ring in a named shared memory block, and
+            the viewer polls them at its own pace.  Nothing is formatted on
+            the test thread and Publish never waits:
+
+            - a frame for a (page, DUT) the viewer has not read yet is
+              overwritten in place (coalesced),
+            - when the ring is full the oldest unread frame is dropped.
+
+            Each slot is guarded by a sequence number (odd while being
+            written), so a reader that races a writer simply reads again.
+            A slot still not readable after VIEW_MAX_SPINS tries (the
+            publisher died while writing it) is skipped and counted as stale.
+            Open attaches a reader, which can stand in for the front panel
+            in tests.
+
+            Image::View and VolImage::View publish here when a publisher has
+            been set with ViewRing::SetPublisher, and fall back to
+            CTestbench::LVImageView otherwise.
+
+******************************************************************************/
+#ifndef _VIEW_RING_H_
+#define _VIEW_RING_H_
+
+#include <atomic>
+
+#include "Defines.h"
+
+#define VIEW_MAX_BYTES          ((NUM_RAM_REG > MAX_PAGE_SIZE) ? NUM_RAM_REG : MAX_PAGE_SIZE)
+#define VIEW_DEFAULT_SLOTS      64
+#define VIEW_DEFAULT_NAME       "DangerzoneViewRing"
+#define VIEW_MAGIC              0x32575652      // "RVW2"
+#define VIEW_MAX_SPINS          100000          // reads of one slot before it is skipped
+
+//-----------------------------------------------------------------------------
+//  one image frame as the viewer sees it
+typedef struct ViewFrame
+{
+    byte            page;
+    byte            hasRef;             // ref holds a reference image
+    word            dut;                // 0 based
+    word            length;             // bytes in data (and ref)
+    word            reserved;
+    dword           sequence;           // publish count when written
+    byte            data[VIEW_MAX_BYTES];
+    byte            ref[VIEW_MAX_BYTES];
+} ViewFrame;
+
+//-----------------------------------------------------------------------------
+//  shared memory layout
+typedef struct ViewSlot
+{
+    std::atomic<dword> seq;             // odd while the frame is written
+    ViewFrame       frame;
+} ViewSlot;
+
+typedef struct ViewHeader
+{
+    dword           magic;
+    dword           slots;
+    dword           slotSize;           // sizeof(ViewSlot) of the publisher
+    std::atomic<dword> head;            // frames appended (writer)
+    std::atomic<dword> tail;            // frames consumed or dropped
+    std::atomic<dword> published;
+    std::atomic<dword> coalesced;
+    std::atomic<dword> dropped;
+} ViewHeader;
+
+//-----------------------------------------------------------------------------
+//  ViewRing class definition
+class ViewRing
+{
+private:
+    ViewHeader* Header;
+    ViewSlot* Slots;
+    void* Memory;
+    void* Handle;
+    dword Size;
+    bool Owner;
+    String Name;
+    dword Stale;                        // slots the reader skipped
+
+    static ViewRing* Publisher;
+
+    ViewRing(const ViewRing&);
+    ViewRing& operator=(const ViewRing&);
+
+    int Map(char* name, dword slots, bool create);
+    void WriteSlot(ViewSlot& slot, byte page, int dut, const byte* raw, const byte* ref, int count, int stride);
+
+public:
+    ViewRing(void);
+    ~ViewRing(void);
+
+    int Create(char* name = VIEW_DEFAULT_NAME, dword slots = VIEW_DEFAULT_SLOTS);
+    int Open(char* name = VIEW_DEFAULT_NAME);
+    void Close(void);
+    bool IsOpen(void) { return (this->Header != NULL); }
+
+    // raw and ref are columns of an Image::Raw style array (stride bytes
+    // between registers), ref may be NULL
+    void Publish(byte page, int dut, const byte* raw, const byte* ref, int count, int stride = TOOL_MAX_DUT);
+    bool Poll(ViewFrame& frame);
+
+    dword GetPublished(void) { return this->IsOpen() ? this->Header->published.load() : 0; }
+    dword GetCoalesced(void) { return this->IsOpen() ? this->Header->coalesced.load() : 0; }
+    dword GetDropped(void) { return this->IsOpen() ? this->Header->dropped.load() : 0; }
+    int GetPending(void);
+    dword GetStale(void) { return this->Stale; }
+
+    static void SetPublisher(ViewRing* ring) { ViewRing::Publisher = ring; }
+    static ViewRing* GetPublisher(void) { return ViewRing::Publisher; }
+};
+
+#endif